@@ -1,105 +1,348 @@
 // Smart Timer blocking-read driver (Week 9)
 // Platform driver + misc char device for blocking read on timer wrap
 
+#include <linux/debugfs.h>
 #include <linux/fs.h>
+#include <linux/idr.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/math64.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/regmap.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/sysfs.h>
+#include <linux/timekeeping.h>
 #include <linux/uaccess.h>
 
+#include "smarttimer_pace.h"
+#include "smarttimer_uapi.h"
+
+#define CREATE_TRACE_POINTS
+#include "smarttimer_trace.h"
+
 #define CTRL_OFFSET 0x00
 #define STATUS_OFFSET 0x04
 #define PERIOD_OFFSET 0x08
 #define DUTY_OFFSET 0x0C
-
+#define CYCLE_OFFSET 0x10     // free-running cycle counter
+#define WRAP_CYC_OFFSET 0x14  // CYCLE latched at the first wrap since the last ack
+#define WRAP_CNT_OFFSET 0x18  // total wraps, free-running
+#define COAL_THRESH_OFFSET 0x1C
+#define COAL_HOLDOFF_OFFSET 0x20
+#define FIFO_PERIOD_OFFSET 0x24  // staged period for the next push
+#define FIFO_DUTY_OFFSET 0x28    // write pushes (FIFO_PERIOD, duty)
+#define FIFO_LEVEL_OFFSET 0x2C
+#define FIFO_WMARK_OFFSET 0x30
+#define FIFO_IE_OFFSET 0x34
+#define STAGE_PERIOD_OFFSET 0x38  // loaded into PERIOD by CTRL.COMMIT
+#define STAGE_DUTY_OFFSET 0x3C    // loaded into DUTY by CTRL.COMMIT
+
+#define CTRL_EN_BIT (1u << 0)
+#define CTRL_RST_BIT (1u << 1)
+#define CTRL_FIFO_EN_BIT (1u << 2)
+#define CTRL_ARM_BIT (1u << 3)  // start on the shared strobe
+#define CTRL_GO_BIT (1u << 4)   // pulse the shared strobe
+#define CTRL_COMMIT_BIT (1u << 5)  // load STAGE_PERIOD/STAGE_DUTY together
+#define CTRL_MASK 0x1Fu  // EN, RST, FIFO_EN, ARM, GO
+#define CTRL_PLAY_BITS (CTRL_EN_BIT | CTRL_FIFO_EN_BIT)  // the FIFO drains only with both
 #define STATUS_WRAP_BIT (1u << 0)
+#define STATUS_FIFO_LOW_BIT (1u << 2)
+#define STATUS_FIFO_UNDERRUN_BIT (1u << 3)
+#define STATUS_MASK 0xFu
+
+#define FIFO_DEPTH 64  // must match 2**FIFO_AW in the RTL
+#define FIFO_CHUNK 32  // entries copied from userspace per batch
+
+// One waveform step as written to /dev/smarttimer0
+struct st_fifo_entry {
+    u32 period;
+    u32 duty;
+};
+
+// Latency histogram in clock cycles, log2 buckets: bucket i holds [2^i, 2^(i+1))
+#define LAT_BUCKETS 32
+
+struct st_lat_hist {
+    u64 count;
+    u64 sum;
+    u32 min;
+    u32 max;
+    u64 bucket[LAT_BUCKETS];
+};
 
 struct smarttimer_dev {
     struct device* dev;
-    void __iomem* base;
+    struct regmap* regmap;  // MMIO, caches the driver-owned config registers
     int irq;
+    int id;                 // instance number: /dev/smarttimer<id>
+    struct list_head node;  // on smarttimer_list
 
     wait_queue_head_t wait;  // for blocking read
+    struct atomic_notifier_head wrap_nh;  // in-kernel wrap hook (smarttimer_pace.h)
     atomic_t wrap_count;     // increments per wrap
+    atomic_t irq_handled;    // interrupts taken (< wraps when coalescing)
+    u32 hw_wrap_last;        // WRAP_CNT seen by the last IRQ
+
+    // Waveform playback (write path)
+    struct mutex fifo_lock;       // one streaming writer at a time
+    wait_queue_head_t fifo_wait;  // writer waits for FIFO_LOW
+    spinlock_t lock;              // fifo_ie together with FIFO_IE
+    bool fifo_ie;                 // FIFO_IE armed; cleared by the IRQ
+
+    // Latency measurement (cycles of the PL clock)
+    spinlock_t lat_lock;
+    struct st_lat_hist lat_irq;   // wrap -> IRQ handler
+    struct st_lat_hist lat_wake;  // IRQ handler -> reader running
+    u32 irq_cyc;                  // CYCLE sampled in the last IRQ handler
+    struct dentry* dbg_dir;
+
+    struct page* status_page;          // mapped read-only by userspace
+    struct smarttimer_status* status;  // its kernel address
 
     struct miscdevice miscdev;  // char device
 };
 
-static irqreturn_t smarttimer_irq_handler(int irq, void* dev_id) {
-    struct smarttimer_dev* st = dev_id;
-    u32 status = readl(st->base + STATUS_OFFSET);
+// All probed instances, for group start
+static DEFINE_IDA(smarttimer_ida);
+static LIST_HEAD(smarttimer_list);
+static DEFINE_MUTEX(smarttimer_list_lock);
+
+// ---------- register access (regmap-mmio) ----------
+
+// Registers the hardware changes on its own, or where access has side effects,
+// always go to the bus. PERIOD/DUTY and the other config registers only read
+// back what the driver wrote, so they are served from the cache.
+static bool st_volatile_reg(struct device* dev, unsigned int reg) {
+    switch (reg) {
+    case CTRL_OFFSET:       // RST is W1P
+    case STATUS_OFFSET:
+    case CYCLE_OFFSET:
+    case WRAP_CYC_OFFSET:
+    case WRAP_CNT_OFFSET:
+    case FIFO_DUTY_OFFSET:  // write pushes
+    case FIFO_LEVEL_OFFSET:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    if (!(status & STATUS_WRAP_BIT))
-        return IRQ_NONE;
+static bool st_readable_reg(struct device* dev, unsigned int reg) {
+    return reg <= STAGE_DUTY_OFFSET && reg != FIFO_DUTY_OFFSET;
+}
+
+static bool st_writeable_reg(struct device* dev, unsigned int reg) {
+    switch (reg) {
+    case CYCLE_OFFSET:
+    case WRAP_CYC_OFFSET:
+    case WRAP_CNT_OFFSET:
+    case FIFO_LEVEL_OFFSET:
+        return false;
+    default:
+        return reg <= STAGE_DUTY_OFFSET;
+    }
+}
+
+static const struct regmap_config st_regmap_config = {
+    .reg_bits = 32,
+    .val_bits = 32,
+    .reg_stride = 4,
+    .max_register = STAGE_DUTY_OFFSET,
+    .volatile_reg = st_volatile_reg,
+    .readable_reg = st_readable_reg,
+    .writeable_reg = st_writeable_reg,
+    .cache_type = REGCACHE_RBTREE,  // filled from hardware on first read
+};
+
+static u32 st_rd(struct smarttimer_dev* st, unsigned int reg) {
+    unsigned int v = 0;
+    regmap_read(st->regmap, reg, &v);
+    return v;
+}
+
+static void st_wr(struct smarttimer_dev* st, unsigned int reg, u32 v) {
+    regmap_write(st->regmap, reg, v);
+}
+
+static void st_lat_reset(struct st_lat_hist* h) {
+    memset(h, 0, sizeof(*h));
+    h->min = U32_MAX;
+}
+
+static void st_lat_record(struct st_lat_hist* h, u32 cycles) {
+    int b = cycles ? fls(cycles) - 1 : 0;
+
+    h->count++;
+    h->sum += cycles;
+    if (cycles < h->min) h->min = cycles;
+    if (cycles > h->max) h->max = cycles;
+    h->bucket[b]++;
+}
+
+static void smarttimer_handle_wrap(struct smarttimer_dev* st) {
+    u32 ts[3];  // CYCLE, WRAP_CYC, WRAP_CNT (contiguous)
+    u32 now, wrap_cyc, hw_wraps;
+
+    // Sample timestamps before the ack re-arms the WRAP_CYC latch
+    regmap_bulk_read(st->regmap, CYCLE_OFFSET, ts, ARRAY_SIZE(ts));
+    now = ts[0];
+    wrap_cyc = ts[1];
+    hw_wraps = ts[2];
+
+    spin_lock(&st->lat_lock);
+    st_lat_record(&st->lat_irq, now - wrap_cyc);  // u32 math handles rollover
+    spin_unlock(&st->lat_lock);
+    WRITE_ONCE(st->irq_cyc, now);
+
+    // Ack source, account every wrap since the last IRQ, then wake sleepers.
+    // WRAP_CNT is free-running, so wraps that land after the sample are
+    // simply picked up by the next IRQ.
+    st_wr(st, STATUS_OFFSET, STATUS_WRAP_BIT);
+    trace_smarttimer_irq(st->id, hw_wraps - st->hw_wrap_last, now - wrap_cyc);
+    atomic_notifier_call_chain(&st->wrap_nh, hw_wraps - st->hw_wrap_last, st);
+    atomic_add(hw_wraps - st->hw_wrap_last, &st->wrap_count);
+    st->hw_wrap_last = hw_wraps;
+    atomic_inc(&st->irq_handled);
+
+    // Publish to the mmap status page; the handler is the only writer
+    WRITE_ONCE(st->status->seq, st->status->seq + 1);
+    smp_wmb();
+    st->status->wrap_count = atomic_read(&st->wrap_count);
+    st->status->last_irq_ns = ktime_get_ns();
+    st->status->last_wrap_cyc = wrap_cyc;
+    st->status->irq_handled = atomic_read(&st->irq_handled);
+    smp_wmb();
+    WRITE_ONCE(st->status->seq, st->status->seq + 1);
 
-    // Ack source and bump count, then wake sleepers
-    writel(STATUS_WRAP_BIT, st->base + STATUS_OFFSET);
-    atomic_inc(&st->wrap_count);
     wake_up_interruptible(&st->wait);
-    dev_info_ratelimited(st->dev, "wrap IRQ, count=%d\n", 
-        atomic_read(&st->wrap_count));
-    return IRQ_HANDLED;
+}
+
+// Arm FIFO_IE for a writer about to sleep. The flag and the register change
+// together under st->lock, and STATUS/CTRL are re-read once the interrupt is
+// on: returns 0 if armed, 1 if the FIFO already drained to the watermark, or
+// -EAGAIN if EN or FIFO_EN is clear and FIFO_LOW can never fire.
+static int st_fifo_arm(struct smarttimer_dev* st) {
+    unsigned long flags;
+    int ret = 0;
+
+    spin_lock_irqsave(&st->lock, flags);
+    st->fifo_ie = true;
+    st_wr(st, FIFO_IE_OFFSET, 1);
+    if ((st_rd(st, CTRL_OFFSET) & CTRL_PLAY_BITS) != CTRL_PLAY_BITS)
+        ret = -EAGAIN;
+    else if (st_rd(st, STATUS_OFFSET) & STATUS_FIFO_LOW_BIT)
+        ret = 1;
+    if (ret) {
+        st_wr(st, FIFO_IE_OFFSET, 0);
+        st->fifo_ie = false;
+    }
+    spin_unlock_irqrestore(&st->lock, flags);
+    return ret;
+}
+
+// Mask FIFO_IE and wake the writer, if it is armed
+static void st_fifo_disarm(struct smarttimer_dev* st) {
+    unsigned long flags;
+
+    spin_lock_irqsave(&st->lock, flags);
+    if (st->fifo_ie) {
+        st_wr(st, FIFO_IE_OFFSET, 0);
+        WRITE_ONCE(st->fifo_ie, false);
+        wake_up_interruptible(&st->fifo_wait);
+    }
+    spin_unlock_irqrestore(&st->lock, flags);
+}
+
+static irqreturn_t smarttimer_irq_handler(int irq, void* dev_id) {
+    struct smarttimer_dev* st = dev_id;
+    u32 status = st_rd(st, STATUS_OFFSET);
+    irqreturn_t ret = IRQ_NONE;
+
+    // FIFO_LOW is level-triggered: mask it and let the writer refill
+    if (status & STATUS_FIFO_LOW_BIT) {
+        spin_lock(&st->lock);
+        if (st->fifo_ie) {
+            st_wr(st, FIFO_IE_OFFSET, 0);
+            WRITE_ONCE(st->fifo_ie, false);
+            wake_up_interruptible(&st->fifo_wait);
+            ret = IRQ_HANDLED;
+        }
+        spin_unlock(&st->lock);
+    }
+
+    if (status & STATUS_WRAP_BIT) {
+        smarttimer_handle_wrap(st);
+        ret = IRQ_HANDLED;
+    }
+    return ret;
 }
 
 // ---------- sysfs (reuse Week 8 attributes) ----------
 
 static ssize_t ctrl_show(struct device* dev, struct device_attribute* attr, char* buf) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + CTRL_OFFSET) & 0x3u;
+    u32 v = st_rd(st, CTRL_OFFSET) & CTRL_MASK;
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t ctrl_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
     unsigned long val;
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
-    writel(((u32)val) & 0x3u, st->base + CTRL_OFFSET);
+    st_wr(st, CTRL_OFFSET, ((u32)val) & CTRL_MASK);
+    if ((val & CTRL_PLAY_BITS) != CTRL_PLAY_BITS)
+        st_fifo_disarm(st);  // FIFO_LOW will not come; let the writer see it
     return cnt;
 }
 static DEVICE_ATTR_RW(ctrl);
 
 static ssize_t period_show(struct device* dev, struct device_attribute* attr, char* buf) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + PERIOD_OFFSET);
+    u32 v = st_rd(st, PERIOD_OFFSET);
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t period_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
     unsigned long val;
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
-    writel((u32)val, st->base + PERIOD_OFFSET);
+    st_wr(st, PERIOD_OFFSET, (u32)val);
     return cnt;
 }
 static DEVICE_ATTR_RW(period);
 
 static ssize_t duty_show(struct device* dev, struct device_attribute* attr, char* buf) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + DUTY_OFFSET);
+    u32 v = st_rd(st, DUTY_OFFSET);
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t duty_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
     unsigned long val;
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
-    writel((u32)val, st->base + DUTY_OFFSET);
+    st_wr(st, DUTY_OFFSET, (u32)val);
     return cnt;
 }
 static DEVICE_ATTR_RW(duty);
 
 static ssize_t status_show(struct device* dev, struct device_attribute* attr, char* buf) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + STATUS_OFFSET) & 0x3u;
+    u32 v = st_rd(st, STATUS_OFFSET) & STATUS_MASK;
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t status_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
     struct smarttimer_dev* st = dev_get_drvdata(dev);
     unsigned long val;
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
-    if (((u32)val) & STATUS_WRAP_BIT)
-        writel(STATUS_WRAP_BIT, st->base + STATUS_OFFSET);  // W1C ack
+    val &= STATUS_WRAP_BIT | STATUS_FIFO_UNDERRUN_BIT;
+    if (val)
+        st_wr(st, STATUS_OFFSET, (u32)val);  // W1C ack
     return cnt;
 }
 static DEVICE_ATTR_RW(status);
@@ -110,16 +353,145 @@ static ssize_t irq_count_show(struct device* dev, struct device_attribute* attr,
 }
 static DEVICE_ATTR_RO(irq_count);
 
+static ssize_t instance_show(struct device* dev, struct device_attribute* attr, char* buf) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    return scnprintf(buf, PAGE_SIZE, "%d\n", st->id);
+}
+static DEVICE_ATTR_RO(instance);
+
+static ssize_t irq_handled_show(struct device* dev, struct device_attribute* attr, char* buf) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    return scnprintf(buf, PAGE_SIZE, "%d\n", atomic_read(&st->irq_handled));
+}
+static DEVICE_ATTR_RO(irq_handled);
+
+// Coalescing: IRQ after coal_thresh wraps, or coal_holdoff cycles after the
+// first pending wrap (0 = no timeout)
+static ssize_t coal_thresh_show(struct device* dev, struct device_attribute* attr, char* buf) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    u32 v = st_rd(st, COAL_THRESH_OFFSET);
+    return scnprintf(buf, PAGE_SIZE, "%u\n", v);
+}
+static ssize_t coal_thresh_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    unsigned long val;
+    if (kstrtoul(buf, 0, &val)) return -EINVAL;
+    st_wr(st, COAL_THRESH_OFFSET, (u32)val);
+    return cnt;
+}
+static DEVICE_ATTR_RW(coal_thresh);
+
+static ssize_t coal_holdoff_show(struct device* dev, struct device_attribute* attr, char* buf) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    u32 v = st_rd(st, COAL_HOLDOFF_OFFSET);
+    return scnprintf(buf, PAGE_SIZE, "%u\n", v);
+}
+static ssize_t coal_holdoff_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    unsigned long val;
+    if (kstrtoul(buf, 0, &val)) return -EINVAL;
+    st_wr(st, COAL_HOLDOFF_OFFSET, (u32)val);
+    return cnt;
+}
+static DEVICE_ATTR_RW(coal_holdoff);
+
+static ssize_t fifo_level_show(struct device* dev, struct device_attribute* attr, char* buf) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    u32 v = st_rd(st, FIFO_LEVEL_OFFSET);
+    return scnprintf(buf, PAGE_SIZE, "%u\n", v);
+}
+static DEVICE_ATTR_RO(fifo_level);
+
+// Writer is woken once FIFO_LEVEL drops to fifo_wmark
+static ssize_t fifo_wmark_show(struct device* dev, struct device_attribute* attr, char* buf) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    u32 v = st_rd(st, FIFO_WMARK_OFFSET);
+    return scnprintf(buf, PAGE_SIZE, "%u\n", v);
+}
+static ssize_t fifo_wmark_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    unsigned long val;
+    if (kstrtoul(buf, 0, &val) || val >= FIFO_DEPTH) return -EINVAL;
+    st_wr(st, FIFO_WMARK_OFFSET, (u32)val);
+    return cnt;
+}
+static DEVICE_ATTR_RW(fifo_wmark);
+
+// Worst-case wrap->handler latency in cycles; write anything to reset both histograms
+static ssize_t irq_latency_max_show(struct device* dev, struct device_attribute* attr, char* buf) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+    u32 v;
+
+    spin_lock_irq(&st->lat_lock);
+    v = st->lat_irq.max;
+    spin_unlock_irq(&st->lat_lock);
+    return scnprintf(buf, PAGE_SIZE, "%u\n", v);
+}
+static ssize_t irq_latency_max_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t cnt) {
+    struct smarttimer_dev* st = dev_get_drvdata(dev);
+
+    spin_lock_irq(&st->lat_lock);
+    st_lat_reset(&st->lat_irq);
+    st_lat_reset(&st->lat_wake);
+    spin_unlock_irq(&st->lat_lock);
+    return cnt;
+}
+static DEVICE_ATTR_RW(irq_latency_max);
+
 static struct attribute* smarttimer_attrs[] = {
     &dev_attr_ctrl.attr,
     &dev_attr_period.attr,
     &dev_attr_duty.attr,
     &dev_attr_status.attr,
     &dev_attr_irq_count.attr,
+    &dev_attr_instance.attr,
+    &dev_attr_irq_handled.attr,
+    &dev_attr_coal_thresh.attr,
+    &dev_attr_coal_holdoff.attr,
+    &dev_attr_fifo_level.attr,
+    &dev_attr_fifo_wmark.attr,
+    &dev_attr_irq_latency_max.attr,
     NULL,
 };
 ATTRIBUTE_GROUPS(smarttimer);
 
+// ---------- debugfs (latency histograms) ----------
+
+static void st_lat_show_one(struct seq_file* m, const char* name, const struct st_lat_hist* h) {
+    int i;
+
+    seq_printf(m, "%s: count=%llu", name, h->count);
+    if (h->count)
+        seq_printf(m, " min=%u avg=%llu max=%u", h->min,
+                   div64_u64(h->sum, h->count), h->max);
+    seq_puts(m, " (cycles)\n");
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        if (h->bucket[i])
+            seq_printf(m, "  [%10u, %10u) %llu\n", i ? 1u << i : 0u,
+                       i < 31 ? 1u << (i + 1) : U32_MAX, h->bucket[i]);
+    }
+}
+
+static int st_latency_show(struct seq_file* m, void* v) {
+    struct smarttimer_dev* st = m->private;
+    struct st_lat_hist* snap;
+
+    // Snapshot under the lock, print outside it
+    snap = kmalloc_array(2, sizeof(*snap), GFP_KERNEL);
+    if (!snap)
+        return -ENOMEM;
+    spin_lock_irq(&st->lat_lock);
+    snap[0] = st->lat_irq;
+    snap[1] = st->lat_wake;
+    spin_unlock_irq(&st->lat_lock);
+
+    st_lat_show_one(m, "wrap_to_irq", &snap[0]);
+    st_lat_show_one(m, "irq_to_reader", &snap[1]);
+    kfree(snap);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(st_latency);
+
 // ---------- misc device (blocking read) ----------
 
 static int st_open(struct inode* inode, struct file* file) {
@@ -132,25 +504,225 @@ static ssize_t st_read(struct file* file, char __user* ubuf, size_t len, loff_t*
     struct smarttimer_dev* st = file->private_data;
     int target = atomic_read(&st->wrap_count) + 1;
     char out[4] = "1\n";  // minimal payload
+    u32 lat;
 
     if (wait_event_interruptible(st->wait, atomic_read(&st->wrap_count) >= target))
         return -ERESTARTSYS;
 
+    lat = st_rd(st, CYCLE_OFFSET) - READ_ONCE(st->irq_cyc);
+    spin_lock_irq(&st->lat_lock);
+    st_lat_record(&st->lat_wake, lat);
+    spin_unlock_irq(&st->lat_lock);
+    trace_smarttimer_wakeup(st->id, lat);
+
     return simple_read_from_buffer(ubuf, len, ppos, out, 2);
 }
 
+// Stream (period, duty) pairs into the playback FIFO. Fills whatever room
+// the FIFO has, then sleeps on the FIFO_LOW interrupt until it drains to
+// the watermark. Returns the number of bytes queued.
+static ssize_t st_write(struct file* file, const char __user* ubuf, size_t len, loff_t* ppos) {
+    struct smarttimer_dev* st = file->private_data;
+    struct st_fifo_entry kbuf[FIFO_CHUNK];
+    size_t n = len / sizeof(struct st_fifo_entry);
+    size_t done = 0, chunk, i;
+    int ret = 0;
+    u32 room;
+
+    if (n == 0)
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&st->fifo_lock))
+        return -ERESTARTSYS;
+
+    while (done < n) {
+        room = FIFO_DEPTH - st_rd(st, FIFO_LEVEL_OFFSET);
+        if (room == 0) {
+            if (file->f_flags & O_NONBLOCK) {
+                ret = -EAGAIN;
+                break;
+            }
+            ret = st_fifo_arm(st);
+            if (ret < 0)
+                break;  // playback off: the FIFO would never drain
+            if (ret == 0) {
+                ret = wait_event_interruptible(st->fifo_wait, !READ_ONCE(st->fifo_ie));
+                if (ret) {
+                    st_fifo_disarm(st);
+                    break;
+                }
+            }
+            ret = 0;
+            continue;
+        }
+
+        chunk = min3((size_t)room, n - done, (size_t)FIFO_CHUNK);
+        if (copy_from_user(kbuf, ubuf + done * sizeof(kbuf[0]), chunk * sizeof(kbuf[0]))) {
+            ret = -EFAULT;
+            break;
+        }
+        // FIFO_PERIOD is sticky and cached, so update_bits skips the bus
+        // write and constant-period waveforms cost one write per step
+        for (i = 0; i < chunk; i++) {
+            regmap_update_bits(st->regmap, FIFO_PERIOD_OFFSET, ~0u, kbuf[i].period);
+            st_wr(st, FIFO_DUTY_OFFSET, kbuf[i].duty);
+        }
+        done += chunk;
+    }
+
+    mutex_unlock(&st->fifo_lock);
+    if (done)
+        return done * sizeof(struct st_fifo_entry);
+    return ret;
+}
+
+// Start every instance in mask (bit n = /dev/smarttimer<n>) on the same
+// clock edge: arm them all (EN stays low), then pulse GO on one. Needs the
+// instances' start_out/start_in strobes wired together in the block design.
+static int st_group_start(u32 mask) {
+    struct smarttimer_dev* st;
+    struct smarttimer_dev* go = NULL;
+    u32 found = 0;
+    int ret = 0;
+
+    mutex_lock(&smarttimer_list_lock);
+    list_for_each_entry(st, &smarttimer_list, node) {
+        if (st->id < 32 && (mask & BIT(st->id)))
+            found |= BIT(st->id);
+    }
+    if (!mask || found != mask) {
+        ret = -ENODEV;
+        goto out;
+    }
+
+    list_for_each_entry(st, &smarttimer_list, node) {
+        if (st->id >= 32 || !(mask & BIT(st->id)))
+            continue;
+        ret = regmap_update_bits(st->regmap, CTRL_OFFSET,
+                                 CTRL_EN_BIT | CTRL_RST_BIT | CTRL_ARM_BIT | CTRL_GO_BIT,
+                                 CTRL_ARM_BIT);
+        if (ret)
+            goto out;
+        go = st;
+    }
+    ret = regmap_update_bits(go->regmap, CTRL_OFFSET, CTRL_GO_BIT, CTRL_GO_BIT);
+out:
+    mutex_unlock(&smarttimer_list_lock);
+    return ret;
+}
+
+// Apply period, duty and CTRL in one call. Separate PERIOD and DUTY writes
+// each arm a commit, so a wrap landing between them would run a mixed pair.
+// Instead both go to the STAGE registers, which the timer ignores, and the
+// CTRL write carries COMMIT: that one write loads both shadows, and a running
+// timer switches to the new pair on its next wrap.
+static long st_ioctl(struct file* file, unsigned int cmd, unsigned long arg) {
+    struct smarttimer_dev* st = file->private_data;
+    struct smarttimer_config cfg;
+    int ret;
+
+    switch (cmd) {
+    case SMARTTIMER_IOC_APPLY: {
+        struct reg_sequence seq[3];
+
+        if (copy_from_user(&cfg, (void __user*)arg, sizeof(cfg)))
+            return -EFAULT;
+        seq[0] = (struct reg_sequence){ STAGE_PERIOD_OFFSET, cfg.period };
+        seq[1] = (struct reg_sequence){ STAGE_DUTY_OFFSET, cfg.duty };
+        seq[2] = (struct reg_sequence){ CTRL_OFFSET, (cfg.ctrl & CTRL_MASK) | CTRL_COMMIT_BIT };
+        ret = regmap_multi_reg_write(st->regmap, seq, ARRAY_SIZE(seq));
+        // The hardware changed PERIOD/DUTY behind the cache
+        regcache_drop_region(st->regmap, PERIOD_OFFSET, DUTY_OFFSET);
+        if ((cfg.ctrl & CTRL_PLAY_BITS) != CTRL_PLAY_BITS)
+            st_fifo_disarm(st);
+        return ret;
+    }
+    case SMARTTIMER_IOC_GROUP_START: {
+        __u32 mask;
+
+        if (get_user(mask, (__u32 __user*)arg))
+            return -EFAULT;
+        return st_group_start(mask);
+    }
+    default:
+        return -ENOTTY;
+    }
+}
+
+// ---------- in-kernel wrap hook ----------
+
+int smarttimer_wrap_notifier_register(int id, struct notifier_block* nb) {
+    struct smarttimer_dev* st;
+    int ret = -ENODEV;
+
+    mutex_lock(&smarttimer_list_lock);
+    list_for_each_entry(st, &smarttimer_list, node) {
+        if (st->id == id) {
+            ret = atomic_notifier_chain_register(&st->wrap_nh, nb);
+            break;
+        }
+    }
+    mutex_unlock(&smarttimer_list_lock);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(smarttimer_wrap_notifier_register);
+
+// Returns once no callback to nb is running. A no-op if the instance is gone.
+void smarttimer_wrap_notifier_unregister(int id, struct notifier_block* nb) {
+    struct smarttimer_dev* st;
+
+    mutex_lock(&smarttimer_list_lock);
+    list_for_each_entry(st, &smarttimer_list, node) {
+        if (st->id == id) {
+            atomic_notifier_chain_unregister(&st->wrap_nh, nb);
+            break;
+        }
+    }
+    mutex_unlock(&smarttimer_list_lock);
+}
+EXPORT_SYMBOL_GPL(smarttimer_wrap_notifier_unregister);
+
+// Map the status page read-only so userspace can sample it without syscalls
+static int st_mmap(struct file* file, struct vm_area_struct* vma) {
+    struct smarttimer_dev* st = file->private_data;
+
+    if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_SIZE)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    vm_flags_clear(vma, VM_MAYWRITE);
+
+    // The mapping takes its own page reference, dropped when it is unmapped,
+    // so the page outlives an unbind for as long as userspace keeps it mapped
+    return vm_insert_page(vma, vma->vm_start, st->status_page);
+}
+
 static const struct file_operations st_fops = {
     .owner = THIS_MODULE,
     .open = st_open,
     .read = st_read,
+    .write = st_write,
+    .unlocked_ioctl = st_ioctl,
+    .mmap = st_mmap,
     .llseek = no_llseek,
 };
 
 // ---------- platform glue ----------
 
+static void smarttimer_ida_free(void* data) {
+    struct smarttimer_dev* st = data;
+    ida_free(&smarttimer_ida, st->id);
+}
+
+// Drop the driver's reference; the page is freed once no mapping holds one
+static void smarttimer_status_put(void* data) {
+    put_page(data);
+}
+
 static int smarttimer_probe(struct platform_device* pdev) {
     struct smarttimer_dev* st;
     struct resource* res;
+    void __iomem* base;
     int ret;
 
     st = devm_kzalloc(&pdev->dev, sizeof(*st), GFP_KERNEL);
@@ -165,10 +737,16 @@ static int smarttimer_probe(struct platform_device* pdev) {
         return -ENODEV;
     }
 
-    st->base = devm_ioremap_resource(&pdev->dev, res);
-    if (IS_ERR(st->base)) {
+    base = devm_ioremap_resource(&pdev->dev, res);
+    if (IS_ERR(base)) {
         dev_err(&pdev->dev, "ioremap failed\n");
-        return PTR_ERR(st->base);
+        return PTR_ERR(base);
+    }
+
+    st->regmap = devm_regmap_init_mmio(&pdev->dev, base, &st_regmap_config);
+    if (IS_ERR(st->regmap)) {
+        dev_err(&pdev->dev, "regmap init failed\n");
+        return PTR_ERR(st->regmap);
     }
 
     st->irq = platform_get_irq(pdev, 0);
@@ -177,9 +755,35 @@ static int smarttimer_probe(struct platform_device* pdev) {
         return st->irq;
     }
 
+    st->status_page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+    if (!st->status_page)
+        return -ENOMEM;
+    ret = devm_add_action_or_reset(&pdev->dev, smarttimer_status_put, st->status_page);
+    if (ret)
+        return ret;
+    st->status = page_address(st->status_page);
+
     init_waitqueue_head(&st->wait);
+    ATOMIC_INIT_NOTIFIER_HEAD(&st->wrap_nh);
+    init_waitqueue_head(&st->fifo_wait);
+    mutex_init(&st->fifo_lock);
+    spin_lock_init(&st->lock);
     atomic_set(&st->wrap_count, 0);
+    atomic_set(&st->irq_handled, 0);
+    st->hw_wrap_last = st_rd(st, WRAP_CNT_OFFSET);
+    spin_lock_init(&st->lat_lock);
+    st_lat_reset(&st->lat_irq);
+    st_lat_reset(&st->lat_wake);
+
+    st->id = ida_alloc(&smarttimer_ida, GFP_KERNEL);
+    if (st->id < 0)
+        return st->id;
+    ret = devm_add_action_or_reset(&pdev->dev, smarttimer_ida_free, st);
+    if (ret)
+        return ret;
 
+    // Instances sharing a line each get their handler called; a non-matching
+    // instance costs one STATUS read before returning IRQ_NONE
     ret = devm_request_irq(&pdev->dev, st->irq, smarttimer_irq_handler,
                            IRQF_SHARED, dev_name(&pdev->dev), st);
     if (ret) {
@@ -188,7 +792,9 @@ static int smarttimer_probe(struct platform_device* pdev) {
     }
 
     st->miscdev.minor = MISC_DYNAMIC_MINOR;
-    st->miscdev.name = "smarttimer0";
+    st->miscdev.name = devm_kasprintf(&pdev->dev, GFP_KERNEL, "smarttimer%d", st->id);
+    if (!st->miscdev.name)
+        return -ENOMEM;
     st->miscdev.fops = &st_fops;
     st->miscdev.mode = 0660;
 
@@ -198,14 +804,28 @@ static int smarttimer_probe(struct platform_device* pdev) {
         return ret;
     }
 
-    dev_info(&pdev->dev, "SmartTimer blocking driver probed: base=%pR, irq=%d\n",
-             res, st->irq);
+    st->dbg_dir = debugfs_create_dir(dev_name(&pdev->dev), NULL);
+    debugfs_create_file("latency", 0444, st->dbg_dir, st, &st_latency_fops);
+
+    mutex_lock(&smarttimer_list_lock);
+    list_add_tail(&st->node, &smarttimer_list);
+    mutex_unlock(&smarttimer_list_lock);
+
+    dev_info(&pdev->dev, "SmartTimer blocking driver probed: /dev/%s base=%pR, irq=%d\n",
+             st->miscdev.name, res, st->irq);
     return 0;
 }
 
 static int smarttimer_remove(struct platform_device* pdev) {
     struct smarttimer_dev* st = platform_get_drvdata(pdev);
+
+    mutex_lock(&smarttimer_list_lock);
+    list_del(&st->node);
+    mutex_unlock(&smarttimer_list_lock);
+
+    debugfs_remove_recursive(st->dbg_dir);
     misc_deregister(&st->miscdev);
+    st_wr(st, FIFO_IE_OFFSET, 0);
     return 0;
 }
 
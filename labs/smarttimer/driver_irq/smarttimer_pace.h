@@ -0,0 +1,15 @@
+// Smart Timer in-kernel wrap hook, for drivers that pace their work off the
+// timer (e.g. squarer_dma's timer-paced ring). Not a userspace header.
+#ifndef SMARTTIMER_PACE_H
+#define SMARTTIMER_PACE_H
+
+#include <linux/notifier.h>
+
+// Call nb on every wrap IRQ of /dev/smarttimer<id>. The callback runs in
+// hard-IRQ context; action is the number of wraps since the previous IRQ
+// (more than one when coalescing). -ENODEV if no such instance.
+// Users that must not pin the module at load can bind with symbol_get().
+int smarttimer_wrap_notifier_register(int id, struct notifier_block* nb);
+void smarttimer_wrap_notifier_unregister(int id, struct notifier_block* nb);
+
+#endif  // SMARTTIMER_PACE_H
@@ -0,0 +1,50 @@
+// Trace events for the smart timer blocking driver
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM smarttimer
+
+#if !defined(_SMARTTIMER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SMARTTIMER_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// IRQ handler: wraps accounted by this interrupt and wrap->handler cycles
+TRACE_EVENT(smarttimer_irq,
+    TP_PROTO(int id, u32 wraps, u32 latency_cyc),
+    TP_ARGS(id, wraps, latency_cyc),
+    TP_STRUCT__entry(
+        __field(int, id)
+        __field(u32, wraps)
+        __field(u32, latency_cyc)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __entry->wraps = wraps;
+        __entry->latency_cyc = latency_cyc;
+    ),
+    TP_printk("id=%d wraps=%u latency_cyc=%u",
+              __entry->id, __entry->wraps, __entry->latency_cyc)
+);
+
+// Blocked reader running again: handler->reader cycles
+TRACE_EVENT(smarttimer_wakeup,
+    TP_PROTO(int id, u32 latency_cyc),
+    TP_ARGS(id, latency_cyc),
+    TP_STRUCT__entry(
+        __field(int, id)
+        __field(u32, latency_cyc)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __entry->latency_cyc = latency_cyc;
+    ),
+    TP_printk("id=%d latency_cyc=%u", __entry->id, __entry->latency_cyc)
+);
+
+#endif  // _SMARTTIMER_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE smarttimer_trace
+#include <trace/define_trace.h>
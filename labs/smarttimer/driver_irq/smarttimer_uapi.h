@@ -0,0 +1,34 @@
+// Smart Timer userspace interface (shared by driver and applications)
+#ifndef SMARTTIMER_UAPI_H
+#define SMARTTIMER_UAPI_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+// Read-only status page: mmap(NULL, 4096, PROT_READ, MAP_SHARED, fd, 0) on
+// /dev/smarttimer0. Updated by the IRQ handler seqlock-style: seq is odd
+// while an update is in progress. Readers retry until they see the same
+// even seq before and after copying the fields.
+struct smarttimer_status {
+    __u32 seq;
+    __u32 wrap_count;     // total wraps (same as sysfs irq_count)
+    __u64 last_irq_ns;    // CLOCK_MONOTONIC time of the last IRQ
+    __u32 last_wrap_cyc;  // WRAP_CYC of the last IRQ (PL clock cycles)
+    __u32 irq_handled;    // interrupts taken
+};
+
+// SMARTTIMER_IOC_APPLY: write PERIOD, DUTY and CTRL in a single call. A
+// running timer switches to the new period and duty on the same wrap.
+struct smarttimer_config {
+    __u32 period;
+    __u32 duty;
+    __u32 ctrl;  // CTRL bits: EN, RST, FIFO_EN, ARM, GO
+};
+
+#define SMARTTIMER_IOC_MAGIC 'T'
+#define SMARTTIMER_IOC_APPLY _IOW(SMARTTIMER_IOC_MAGIC, 1, struct smarttimer_config)
+// SMARTTIMER_IOC_GROUP_START: start the instances in a __u32 mask
+// (bit n = /dev/smarttimer<n>) on the same clock edge. Any instance's fd works.
+#define SMARTTIMER_IOC_GROUP_START _IOW(SMARTTIMER_IOC_MAGIC, 2, __u32)
+
+#endif  // SMARTTIMER_UAPI_H
@@ -4,6 +4,7 @@
 #include <linux/io.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
+#include <linux/regmap.h>
 #include <linux/sysfs.h>
 
 MODULE_LICENSE("GPL");
@@ -19,14 +20,42 @@ MODULE_DESCRIPTION("Week 6: Smart Timer platform driver (DT-bound, simple sysfs)
 #define STATUS_WRAP_BIT (1u << 0)
 
 struct smarttimer_dev {
-    void __iomem *base;
+    struct regmap *regmap;
     struct device *dev;
 };
 
+// PERIOD/DUTY read back the shadow registers the driver wrote, so serve
+// them from the regmap cache; CTRL (W1P RST) and STATUS always hit the bus
+static bool st_volatile_reg(struct device *dev, unsigned int reg)
+{
+    return reg == OFF_CTRL || reg == OFF_STATUS;
+}
+
+static const struct regmap_config st_regmap_config = {
+    .reg_bits     = 32,
+    .val_bits     = 32,
+    .reg_stride   = 4,
+    .max_register = OFF_DUTY,
+    .volatile_reg = st_volatile_reg,
+    .cache_type   = REGCACHE_RBTREE,
+};
+
+static u32 st_rd(struct smarttimer_dev *st, unsigned int reg)
+{
+    unsigned int v = 0;
+    regmap_read(st->regmap, reg, &v);
+    return v;
+}
+
+static void st_wr(struct smarttimer_dev *st, unsigned int reg, u32 v)
+{
+    regmap_write(st->regmap, reg, v);
+}
+
 static ssize_t ctrl_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
     struct smarttimer_dev *st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + OFF_CTRL) & 0x3u; // only bits [1:0]
+    u32 v = st_rd(st, OFF_CTRL) & 0x3u; // only bits [1:0]
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t ctrl_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t cnt)
@@ -34,7 +63,7 @@ static ssize_t ctrl_store(struct device *dev, struct device_attribute *attr, con
     struct smarttimer_dev *st = dev_get_drvdata(dev);
     unsigned long val;
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
-    writel(((u32)val) & 0x3u, st->base + OFF_CTRL);
+    st_wr(st, OFF_CTRL, ((u32)val) & 0x3u);
     return cnt;
 }
 static DEVICE_ATTR_RW(ctrl);
@@ -42,7 +71,7 @@ static DEVICE_ATTR_RW(ctrl);
 static ssize_t period_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
     struct smarttimer_dev *st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + OFF_PERIOD);
+    u32 v = st_rd(st, OFF_PERIOD);
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t period_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t cnt)
@@ -50,7 +79,7 @@ static ssize_t period_store(struct device *dev, struct device_attribute *attr, c
     struct smarttimer_dev *st = dev_get_drvdata(dev);
     unsigned long val;
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
-    writel((u32)val, st->base + OFF_PERIOD);
+    st_wr(st, OFF_PERIOD, (u32)val);
     return cnt;
 }
 static DEVICE_ATTR_RW(period);
@@ -58,7 +87,7 @@ static DEVICE_ATTR_RW(period);
 static ssize_t duty_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
     struct smarttimer_dev *st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + OFF_DUTY);
+    u32 v = st_rd(st, OFF_DUTY);
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t duty_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t cnt)
@@ -66,7 +95,7 @@ static ssize_t duty_store(struct device *dev, struct device_attribute *attr, con
     struct smarttimer_dev *st = dev_get_drvdata(dev);
     unsigned long val;
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
-    writel((u32)val, st->base + OFF_DUTY);
+    st_wr(st, OFF_DUTY, (u32)val);
     return cnt;
 }
 static DEVICE_ATTR_RW(duty);
@@ -74,7 +103,7 @@ static DEVICE_ATTR_RW(duty);
 static ssize_t status_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
     struct smarttimer_dev *st = dev_get_drvdata(dev);
-    u32 v = readl(st->base + OFF_STATUS) & 0x3u;
+    u32 v = st_rd(st, OFF_STATUS) & 0x3u;
     return scnprintf(buf, PAGE_SIZE, "0x%08x\n", v);
 }
 static ssize_t status_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t cnt)
@@ -84,7 +113,7 @@ static ssize_t status_store(struct device *dev, struct device_attribute *attr, c
     if (kstrtoul(buf, 0, &val)) return -EINVAL;
     // W1C: writing 1 to WRAP bit clears it (RTL handles this)
     if (((u32)val) & STATUS_WRAP_BIT)
-        writel(STATUS_WRAP_BIT, st->base + OFF_STATUS);
+        st_wr(st, OFF_STATUS, STATUS_WRAP_BIT);
     return cnt;
 }
 static DEVICE_ATTR_RW(status);
@@ -102,6 +131,7 @@ static int smarttimer_probe(struct platform_device *pdev)
 {
     struct smarttimer_dev *st;
     struct resource *res;
+    void __iomem *base;
     int rc;
 
     st = devm_kzalloc(&pdev->dev, sizeof(*st), GFP_KERNEL);
@@ -114,10 +144,16 @@ static int smarttimer_probe(struct platform_device *pdev)
         return -ENODEV;
     }
 
-    st->base = devm_ioremap_resource(&pdev->dev, res);
-    if (IS_ERR(st->base)) {
+    base = devm_ioremap_resource(&pdev->dev, res);
+    if (IS_ERR(base)) {
         dev_err(&pdev->dev, "ioremap failed\n");
-        return PTR_ERR(st->base);
+        return PTR_ERR(base);
+    }
+
+    st->regmap = devm_regmap_init_mmio(&pdev->dev, base, &st_regmap_config);
+    if (IS_ERR(st->regmap)) {
+        dev_err(&pdev->dev, "regmap init failed\n");
+        return PTR_ERR(st->regmap);
     }
 
     st->dev = &pdev->dev;
@@ -2,15 +2,45 @@
 // Derived from week07 core (smart_timer_axil) with minimal IRQ addition.
 // Differences vs week07:
 // - Register map adjusted to match week08 driver/tests:
-//   0x00 CTRL   [bit0 EN (RW), bit1 RST (W1P)]
-//   0x04 STATUS [bit0 WRAP (RO/W1C), bit1 UPD_PENDING (RO)]
-//   0x08 PERIOD [RW]
-//   0x0C DUTY   [RW]
-// - irq_out asserts when STATUS.WRAP=1 (cleared by W1C)
+//   0x00 CTRL         [bit0 EN (RW), bit1 RST (W1P), bit2 FIFO_EN (RW),
+//                      bit3 ARM (RW), bit4 GO (W1P), bit5 COMMIT (W1P)]
+//   0x04 STATUS       [bit0 WRAP (RO/W1C), bit1 UPD_PENDING (RO),
+//                      bit2 FIFO_LOW (RO), bit3 FIFO_UNDERRUN (RO/W1C)]
+//   0x08 PERIOD       [RW]
+//   0x0C DUTY         [RW]
+//   0x10 CYCLE        [RO] free-running clock-cycle counter (not gated by EN)
+//   0x14 WRAP_CYC     [RO] CYCLE latched at the first wrap since the last ack
+//   0x18 WRAP_CNT     [RO] total wraps, free-running (never lost to coalescing)
+//   0x1C COAL_THRESH  [RW] set STATUS.WRAP after this many wraps (0/1 = every wrap)
+//   0x20 COAL_HOLDOFF [RW] or this many cycles after the first pending wrap (0 = off)
+//   0x24 FIFO_PERIOD  [RW] period staged for the next FIFO push
+//   0x28 FIFO_DUTY    [WO] push (FIFO_PERIOD, FIFO_DUTY); dropped when full
+//   0x2C FIFO_LEVEL   [RO] entries queued
+//   0x30 FIFO_WMARK   [RW] FIFO_LOW while FIFO_LEVEL <= FIFO_WMARK
+//   0x34 FIFO_IE      [RW] bit0: raise irq_out on FIFO_LOW
+//   0x38 STAGE_PERIOD [RW] period loaded into PERIOD by CTRL.COMMIT
+//   0x3C STAGE_DUTY   [RW] duty loaded into DUTY by CTRL.COMMIT
+// - irq_out asserts when STATUS.WRAP=1 (cleared by W1C) or FIFO_LOW & FIFO_IE
+// - Shadowed PERIOD/DUTY commit on the wrap itself, independent of the IRQ
+// - Each PERIOD or DUTY write arms its own commit, so a wrap between the two
+//   can pick up a mixed pair. To change both at once, write STAGE_PERIOD and
+//   STAGE_DUTY, then CTRL with COMMIT: that single write loads both shadows
+//   (and the rest of CTRL), and the next wrap commits them together
+// - With FIFO_EN, each wrap pops one (period, duty) pair into the active
+//   registers instead; an empty FIFO holds the last values and sets
+//   FIFO_UNDERRUN. RST flushes the FIFO.
+// - CYCLE - WRAP_CYC read from the IRQ handler gives the wrap-to-handler
+//   latency in clock cycles
+// - Synchronized start: OR every timer's start_out into every timer's
+//   start_in. Set ARM on each timer, then GO on any one: all armed timers
+//   set EN on the same clock edge (ARM self-clears). Tie start_in low for a
+//   single timer.
 
 `timescale 1ns/1ps
 
-module smarttimer_axil_irq (
+module smarttimer_axil_irq #(
+  parameter FIFO_AW = 6  // FIFO depth = 2**FIFO_AW entries
+) (
   input  wire        clk,
   input  wire        resetn,
 
@@ -37,6 +67,10 @@ module smarttimer_axil_irq (
   output reg         s_axi_rvalid,
   input  wire        s_axi_rready,
 
+  // Group start strobe
+  input  wire        start_in,
+  output wire        start_out,
+
   // Observable outputs
   output wire        pwm_out,
   output wire        irq_out
@@ -93,65 +127,219 @@ module smarttimer_axil_irq (
   end
 
   wire do_write = aw_hs_done && w_hs_done && ~s_axi_bvalid;
-  wire [1:0] word_sel_w = awaddr_q[3:2];
+  wire [3:0] word_sel_w = awaddr_q[5:2];
 
   // Registers & state (week07 features)
   reg        ctrl_en;
   reg        ctrl_rst_pulse;  // W1P
+  reg        ctrl_fifo_en;
+  reg        ctrl_arm;        // wait for start_in, then set EN
+  reg        ctrl_go_pulse;   // W1P, drives start_out
+  reg [31:0] period_stage, duty_stage;  // STAGE_PERIOD/STAGE_DUTY
   reg [31:0] period_shadow, period_active;
   reg [31:0] duty_shadow,   duty_active;
   reg        upd_pending; // STATUS[1]
   reg        status_wrap; // STATUS[0], sticky W1C
+  reg        fifo_underrun; // STATUS[3], sticky W1C
+  reg [31:0] cycle_cnt;   // CYCLE, free-running
+  reg [31:0] wrap_cyc;    // WRAP_CYC, latched on the first wrap after ack
+  reg [31:0] wrap_cnt;     // WRAP_CNT
+  reg [31:0] coal_thresh;  // COAL_THRESH
+  reg [31:0] coal_holdoff; // COAL_HOLDOFF
+  reg [31:0] coal_pending; // wraps since the last ack
+  reg [31:0] holdoff_cnt;  // cycles since the first pending wrap
+  reg [31:0] fifo_period_stage; // FIFO_PERIOD
+  reg [31:0] fifo_wmark;   // FIFO_WMARK
+  reg        fifo_ie;      // FIFO_IE
+  wire       wrap_pulse;   // from pwm_core
 
   localparam [31:0] PERIOD_RST = 32'h0000_00FF;
   localparam [31:0] DUTY_RST   = 32'h0000_00AA;
 
+  // Interrupt coalescing: raise STATUS.WRAP once COAL_THRESH wraps are
+  // pending, or COAL_HOLDOFF cycles after the first pending wrap
+  wire [31:0] coal_pending_nx = coal_pending + {31'd0, wrap_pulse};
+  wire        coal_cnt_hit    = wrap_pulse && (coal_pending_nx >= coal_thresh);
+  wire        coal_time_hit   = (coal_holdoff != 32'd0) && (coal_pending != 32'd0) &&
+                                (holdoff_cnt >= coal_holdoff);
+
+  // (period, duty) FIFO for waveform playback
+  localparam FIFO_DEPTH = 1 << FIFO_AW;
+  reg  [31:0]      fifo_period_mem [0:FIFO_DEPTH-1];
+  reg  [31:0]      fifo_duty_mem   [0:FIFO_DEPTH-1];
+  reg  [FIFO_AW:0] fifo_wr_ptr, fifo_rd_ptr;
+  wire [FIFO_AW:0] fifo_level = fifo_wr_ptr - fifo_rd_ptr;
+  wire             fifo_empty = (fifo_level == 0);
+  wire             fifo_full  = (fifo_level == FIFO_DEPTH);
+  wire             fifo_push  = do_write && (word_sel_w == 4'hA) && !fifo_full;
+  wire             fifo_pop   = ctrl_fifo_en && ctrl_en && wrap_pulse && !fifo_empty;
+  wire             fifo_low   = ctrl_fifo_en && (fifo_level <= fifo_wmark);
+
+  // CTRL write with COMMIT: load the staged pair into both shadows at once
+  wire             commit     = do_write && (word_sel_w == 4'h0) && wstrb_q[0] && wdata_q[5];
+
+  always @(posedge clk) begin
+    if (fifo_push) begin
+      fifo_period_mem[fifo_wr_ptr[FIFO_AW-1:0]] <= fifo_period_stage;
+      fifo_duty_mem[fifo_wr_ptr[FIFO_AW-1:0]]   <= wdata_q;
+    end
+  end
+
+  always @(posedge clk or negedge resetn) begin
+    if (!resetn) begin
+      fifo_wr_ptr <= 0;
+      fifo_rd_ptr <= 0;
+    end else if (ctrl_rst_pulse) begin
+      fifo_wr_ptr <= 0;
+      fifo_rd_ptr <= 0;
+    end else begin
+      if (fifo_push) fifo_wr_ptr <= fifo_wr_ptr + 1'b1;
+      if (fifo_pop)  fifo_rd_ptr <= fifo_rd_ptr + 1'b1;
+    end
+  end
+
+  // Free-running cycle counter (latency timestamps)
+  always @(posedge clk or negedge resetn) begin
+    if (!resetn)
+      cycle_cnt <= 32'd0;
+    else
+      cycle_cnt <= cycle_cnt + 1'b1;
+  end
+
   // Write side-effects
   integer i;
   always @(posedge clk or negedge resetn) begin
     if (!resetn) begin
       ctrl_en        <= 1'b0;
       ctrl_rst_pulse <= 1'b0;
+      ctrl_fifo_en   <= 1'b0;
+      ctrl_arm       <= 1'b0;
+      ctrl_go_pulse  <= 1'b0;
       period_shadow  <= PERIOD_RST;
       duty_shadow    <= DUTY_RST;
+      period_stage   <= PERIOD_RST;
+      duty_stage     <= DUTY_RST;
       upd_pending    <= 1'b0;
       status_wrap    <= 1'b0;
+      wrap_cyc       <= 32'd0;
+      wrap_cnt       <= 32'd0;
+      coal_thresh    <= 32'd1;
+      coal_holdoff   <= 32'd0;
+      coal_pending   <= 32'd0;
+      holdoff_cnt    <= 32'd0;
+      fifo_underrun  <= 1'b0;
+      fifo_period_stage <= PERIOD_RST;
+      fifo_wmark     <= 32'd0;
+      fifo_ie        <= 1'b0;
       s_axi_bvalid   <= 1'b0;
       s_axi_bresp    <= OKAY;
     end else begin
       ctrl_rst_pulse <= 1'b0; // self-clear
+      ctrl_go_pulse  <= 1'b0; // self-clear
+      if (ctrl_arm && start_in) begin
+        ctrl_en  <= 1'b1;
+        ctrl_arm <= 1'b0;
+      end
       // Sticky updates
-      if (wrap_pulse) status_wrap <= 1'b1;
-      if (status_wrap && upd_pending)
+      if (wrap_pulse) wrap_cnt <= wrap_cnt + 1'b1;
+      if (!status_wrap) begin
+        // Timestamp the first pending wrap, not later ones
+        if (wrap_pulse && coal_pending == 32'd0) wrap_cyc <= cycle_cnt;
+        coal_pending <= coal_pending_nx;
+        holdoff_cnt  <= (coal_pending_nx != 32'd0) ? holdoff_cnt + 1'b1 : 32'd0;
+        if (coal_cnt_hit || coal_time_hit) status_wrap <= 1'b1;
+      end
+      if (wrap_pulse && upd_pending)
         upd_pending <= 1'b0;
+      if (ctrl_fifo_en && ctrl_en && wrap_pulse && fifo_empty)
+        fifo_underrun <= 1'b1;
 
       if (do_write) begin
         case (word_sel_w)
-          2'b00: begin // CTRL @0x00
+          4'h0: begin // CTRL @0x00
             if (wstrb_q[0]) begin
               ctrl_en        <= wdata_q[0];
               ctrl_rst_pulse <= wdata_q[1];
+              ctrl_fifo_en   <= wdata_q[2];
+              ctrl_arm       <= wdata_q[3];
+              ctrl_go_pulse  <= wdata_q[4];
+            end
+            if (commit) begin
+              period_shadow <= period_stage;
+              duty_shadow   <= duty_stage;
+              upd_pending   <= ctrl_en; // one commit at the next wrap
             end
             s_axi_bresp <= OKAY;
           end
-          2'b01: begin // STATUS @0x04 (W1C for WRAP)
-            if (wstrb_q[0] && wdata_q[0]) status_wrap <= 1'b0;
+          4'h1: begin // STATUS @0x04 (W1C for WRAP)
+            if (wstrb_q[0] && wdata_q[0]) begin
+              status_wrap  <= 1'b0;
+              coal_pending <= 32'd0;
+              holdoff_cnt  <= 32'd0;
+            end
+            if (wstrb_q[0] && wdata_q[3]) fifo_underrun <= 1'b0;
             s_axi_bresp <= OKAY;
           end
-          2'b10: begin // PERIOD @0x08 (shadowed)
+          4'h2: begin // PERIOD @0x08 (shadowed)
             for (i = 0; i < 4; i = i + 1) begin
               if (wstrb_q[i]) period_shadow[i*8 +: 8] <= wdata_q[i*8 +: 8];
             end
             upd_pending <= ctrl_en; // commit at wrap when running
             s_axi_bresp <= OKAY;
           end
-          2'b11: begin // DUTY @0x0C (shadowed)
+          4'h3: begin // DUTY @0x0C (shadowed)
             for (i = 0; i < 4; i = i + 1) begin
               if (wstrb_q[i]) duty_shadow[i*8 +: 8] <= wdata_q[i*8 +: 8];
             end
             upd_pending <= ctrl_en;
             s_axi_bresp <= OKAY;
           end
+          4'h7: begin // COAL_THRESH @0x1C
+            for (i = 0; i < 4; i = i + 1) begin
+              if (wstrb_q[i]) coal_thresh[i*8 +: 8] <= wdata_q[i*8 +: 8];
+            end
+            s_axi_bresp <= OKAY;
+          end
+          4'h8: begin // COAL_HOLDOFF @0x20
+            for (i = 0; i < 4; i = i + 1) begin
+              if (wstrb_q[i]) coal_holdoff[i*8 +: 8] <= wdata_q[i*8 +: 8];
+            end
+            s_axi_bresp <= OKAY;
+          end
+          4'h9: begin // FIFO_PERIOD @0x24
+            for (i = 0; i < 4; i = i + 1) begin
+              if (wstrb_q[i]) fifo_period_stage[i*8 +: 8] <= wdata_q[i*8 +: 8];
+            end
+            s_axi_bresp <= OKAY;
+          end
+          4'hA: begin // FIFO_DUTY @0x28 (push handled by fifo_push)
+            s_axi_bresp <= OKAY;
+          end
+          4'hC: begin // FIFO_WMARK @0x30
+            for (i = 0; i < 4; i = i + 1) begin
+              if (wstrb_q[i]) fifo_wmark[i*8 +: 8] <= wdata_q[i*8 +: 8];
+            end
+            s_axi_bresp <= OKAY;
+          end
+          4'hD: begin // FIFO_IE @0x34
+            if (wstrb_q[0]) fifo_ie <= wdata_q[0];
+            s_axi_bresp <= OKAY;
+          end
+          4'hE: begin // STAGE_PERIOD @0x38
+            for (i = 0; i < 4; i = i + 1) begin
+              if (wstrb_q[i]) period_stage[i*8 +: 8] <= wdata_q[i*8 +: 8];
+            end
+            s_axi_bresp <= OKAY;
+          end
+          4'hF: begin // STAGE_DUTY @0x3C
+            for (i = 0; i < 4; i = i + 1) begin
+              if (wstrb_q[i]) duty_stage[i*8 +: 8] <= wdata_q[i*8 +: 8];
+            end
+            s_axi_bresp <= OKAY;
+          end
+          default: begin // read-only / unmapped: ignore
+            s_axi_bresp <= OKAY;
+          end
         endcase
         s_axi_bvalid <= 1'b1;
       end
@@ -174,23 +362,71 @@ module smarttimer_axil_irq (
       if (!ar_hs_done && s_axi_arvalid && s_axi_arready) begin
         ar_hs_done <= 1'b1;
         araddr_q   <= s_axi_araddr;
-        case (s_axi_araddr[3:2])
-          2'b00: begin // CTRL readback: EN visible; RST reads as 0
-            s_axi_rdata <= {30'd0, 1'b0, ctrl_en};
+        case (s_axi_araddr[5:2])
+          4'h0: begin // CTRL readback: EN visible; RST reads as 0
+            s_axi_rdata <= {28'd0, ctrl_arm, ctrl_fifo_en, 1'b0, ctrl_en};
             s_axi_rresp <= OKAY;
           end
-          2'b01: begin // STATUS
-            s_axi_rdata <= {30'd0, upd_pending, status_wrap};
+          4'h1: begin // STATUS
+            s_axi_rdata <= {28'd0, fifo_underrun, fifo_low, upd_pending, status_wrap};
             s_axi_rresp <= OKAY;
           end
-          2'b10: begin // PERIOD (shadow)
+          4'h2: begin // PERIOD (shadow)
             s_axi_rdata <= period_shadow;
             s_axi_rresp <= OKAY;
           end
-          2'b11: begin // DUTY (shadow)
+          4'h3: begin // DUTY (shadow)
             s_axi_rdata <= duty_shadow;
             s_axi_rresp <= OKAY;
           end
+          4'h4: begin // CYCLE
+            s_axi_rdata <= cycle_cnt;
+            s_axi_rresp <= OKAY;
+          end
+          4'h5: begin // WRAP_CYC
+            s_axi_rdata <= wrap_cyc;
+            s_axi_rresp <= OKAY;
+          end
+          4'h6: begin // WRAP_CNT
+            s_axi_rdata <= wrap_cnt;
+            s_axi_rresp <= OKAY;
+          end
+          4'h7: begin // COAL_THRESH
+            s_axi_rdata <= coal_thresh;
+            s_axi_rresp <= OKAY;
+          end
+          4'h8: begin // COAL_HOLDOFF
+            s_axi_rdata <= coal_holdoff;
+            s_axi_rresp <= OKAY;
+          end
+          4'h9: begin // FIFO_PERIOD (staged)
+            s_axi_rdata <= fifo_period_stage;
+            s_axi_rresp <= OKAY;
+          end
+          4'hB: begin // FIFO_LEVEL
+            s_axi_rdata <= {{(31-FIFO_AW){1'b0}}, fifo_level};
+            s_axi_rresp <= OKAY;
+          end
+          4'hC: begin // FIFO_WMARK
+            s_axi_rdata <= fifo_wmark;
+            s_axi_rresp <= OKAY;
+          end
+          4'hD: begin // FIFO_IE
+            s_axi_rdata <= {31'd0, fifo_ie};
+            s_axi_rresp <= OKAY;
+          end
+          4'hE: begin // STAGE_PERIOD
+            s_axi_rdata <= period_stage;
+            s_axi_rresp <= OKAY;
+          end
+          4'hF: begin // STAGE_DUTY
+            s_axi_rdata <= duty_stage;
+            s_axi_rresp <= OKAY;
+          end
+          default: begin
+            s_axi_rdata <= 32'd0;
+            s_axi_rresp <= OKAY;
+          end
         endcase
         s_axi_rvalid <= 1'b1;
       end
@@ -203,18 +439,21 @@ module smarttimer_axil_irq (
 
   // PWM integration (week07)
   wire rstn_core = resetn & ~ctrl_rst_pulse; // software reset pulse
-  wire wrap_pulse;
 
-  // Commit active values at wrap or when disabled
+  // Commit active values at wrap (from the FIFO in playback mode) or when disabled
   always @(posedge clk or negedge resetn) begin
     if (!resetn) begin
       period_active <= PERIOD_RST;
       duty_active   <= DUTY_RST;
     end else begin
       if (!ctrl_en) begin
-        period_active <= period_shadow;
-        duty_active   <= duty_shadow;
-      end else if (status_wrap && upd_pending) begin
+        // A COMMIT that also sets EN takes effect from the first period
+        period_active <= commit ? period_stage : period_shadow;
+        duty_active   <= commit ? duty_stage   : duty_shadow;
+      end else if (fifo_pop) begin
+        period_active <= fifo_period_mem[fifo_rd_ptr[FIFO_AW-1:0]];
+        duty_active   <= fifo_duty_mem[fifo_rd_ptr[FIFO_AW-1:0]];
+      end else if (!ctrl_fifo_en && wrap_pulse && upd_pending) begin
         period_active <= period_shadow;
         duty_active   <= duty_shadow;
       end
@@ -231,7 +470,9 @@ module smarttimer_axil_irq (
     .wrap    (wrap_pulse)
   );
 
-  // IRQ asserted on sticky status
-  assign irq_out = status_wrap;
+  assign start_out = ctrl_go_pulse;
+
+  // IRQ asserted on sticky status, or on a low FIFO when enabled
+  assign irq_out = status_wrap | (fifo_low & fifo_ie);
 
 endmodule
@@ -7,6 +7,26 @@ CTRL_OFFSET = 0x0
 STATUS_OFFSET = 0x4
 PERIOD_OFFSET = 0x8
 DUTY_OFFSET = 0xC
+CYCLE_OFFSET = 0x10
+WRAP_CYC_OFFSET = 0x14
+WRAP_CNT_OFFSET = 0x18
+COAL_THRESH_OFFSET = 0x1C
+COAL_HOLDOFF_OFFSET = 0x20
+FIFO_PERIOD_OFFSET = 0x24
+FIFO_DUTY_OFFSET = 0x28
+FIFO_LEVEL_OFFSET = 0x2C
+FIFO_WMARK_OFFSET = 0x30
+FIFO_IE_OFFSET = 0x34
+STAGE_PERIOD_OFFSET = 0x38
+STAGE_DUTY_OFFSET = 0x3C
+
+CTRL_EN = 0x1
+CTRL_FIFO_EN = 0x4
+CTRL_ARM = 0x8
+CTRL_GO = 0x10
+CTRL_COMMIT = 0x20
+STATUS_FIFO_LOW = 0x4
+STATUS_FIFO_UNDERRUN = 0x8
 
 
 def mk_axil_master(dut) -> AxiLiteMaster:
@@ -24,6 +44,7 @@ async def axil_read(axil: AxiLiteMaster, addr: int) -> int:
 
 
 async def reset_dut(dut):
+    dut.start_in.value = 0
     dut.resetn.value = 0
     await ClockCycles(dut.clk, 5)
     dut.resetn.value = 1
@@ -217,3 +238,255 @@ async def test_upd_pending_clears_on_wrap(dut):
     # Check UPD_PENDING cleared
     status = await axil_read(axil, STATUS_OFFSET)
     assert (status & 0x2) == 0, "UPD_PENDING should clear after wrap"
+
+
+@cocotb.test
+async def test_commit_loads_staged_pair(dut):
+    """STAGE_* writes leave the timer alone; one CTRL.COMMIT loads both"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, PERIOD_OFFSET, 8)
+    await axil_write(axil, DUTY_OFFSET, 4)
+    await axil_write(axil, CTRL_OFFSET, CTRL_EN)
+    await ClockCycles(dut.clk, 2)
+
+    await axil_write(axil, STAGE_PERIOD_OFFSET, 40)
+    await axil_write(axil, STAGE_DUTY_OFFSET, 20)
+    await ClockCycles(dut.clk, 20)
+    assert await axil_read(axil, PERIOD_OFFSET) == 8, "staging must not touch PERIOD"
+    assert await axil_read(axil, DUTY_OFFSET) == 4, "staging must not touch DUTY"
+    status = await axil_read(axil, STATUS_OFFSET)
+    assert (status & 0x2) == 0, "staging must not arm a commit"
+
+    await axil_write(axil, CTRL_OFFSET, CTRL_EN | CTRL_COMMIT)
+    await ClockCycles(dut.clk, 1)
+    assert await axil_read(axil, PERIOD_OFFSET) == 40
+    assert await axil_read(axil, DUTY_OFFSET) == 20
+    status = await axil_read(axil, STATUS_OFFSET)
+    assert status & 0x2, "COMMIT should arm one commit at the next wrap"
+    ctrl = await axil_read(axil, CTRL_OFFSET)
+    assert ctrl == CTRL_EN, f"COMMIT should read back as 0, got {ctrl:#x}"
+
+    # Next wrap of the old 8-cycle period commits the pair
+    await ClockCycles(dut.clk, 12)
+    status = await axil_read(axil, STATUS_OFFSET)
+    assert (status & 0x2) == 0, "UPD_PENDING should clear after wrap"
+
+
+@cocotb.test
+async def test_cycle_counter_free_running(dut):
+    """CYCLE advances even while the timer is disabled"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    c0 = await axil_read(axil, CYCLE_OFFSET)
+    await ClockCycles(dut.clk, 50)
+    c1 = await axil_read(axil, CYCLE_OFFSET)
+
+    assert c1 - c0 >= 50, f"CYCLE should advance by >= 50, got {c1 - c0}"
+
+
+@cocotb.test
+async def test_wrap_cycle_latched_on_first_wrap(dut):
+    """WRAP_CYC holds the wrap that raised the IRQ until STATUS.WRAP is acked"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, PERIOD_OFFSET, 8)
+    await axil_write(axil, CTRL_OFFSET, 0x1)
+    await ClockCycles(dut.clk, 12)
+    assert dut.irq_out.value == 1
+
+    first = await axil_read(axil, WRAP_CYC_OFFSET)
+    now = await axil_read(axil, CYCLE_OFFSET)
+    assert first != 0, "WRAP_CYC should be latched on wrap"
+    assert now > first, "CYCLE should be past the latched wrap"
+
+    # More wraps without ack must not move the timestamp
+    await ClockCycles(dut.clk, 30)
+    again = await axil_read(axil, WRAP_CYC_OFFSET)
+    assert again == first, "WRAP_CYC should stay latched until W1C"
+
+    # After ack the next wrap latches a newer timestamp
+    await axil_write(axil, STATUS_OFFSET, 0x1)
+    await ClockCycles(dut.clk, 12)
+    newer = await axil_read(axil, WRAP_CYC_OFFSET)
+    assert newer > first, "WRAP_CYC should re-latch after W1C"
+
+
+@cocotb.test
+async def test_wrap_count_not_lost_while_unacked(dut):
+    """WRAP_CNT counts every wrap even while STATUS.WRAP stays set"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, PERIOD_OFFSET, 9)  # wrap every 10 cycles
+    await axil_write(axil, CTRL_OFFSET, 0x1)
+    await ClockCycles(dut.clk, 105)
+    await axil_write(axil, CTRL_OFFSET, 0x0)
+
+    count = await axil_read(axil, WRAP_CNT_OFFSET)
+    assert 9 <= count <= 11, f"expected ~10 wraps, got {count}"
+
+
+@cocotb.test
+async def test_coalesce_threshold(dut):
+    """With COAL_THRESH=4 the IRQ only asserts on the 4th wrap"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, COAL_THRESH_OFFSET, 4)
+    await axil_write(axil, PERIOD_OFFSET, 9)
+    await axil_write(axil, CTRL_OFFSET, 0x1)
+
+    await ClockCycles(dut.clk, 25)  # ~2 wraps
+    assert dut.irq_out.value == 0, "IRQ should be held off below threshold"
+
+    await ClockCycles(dut.clk, 25)  # ~4-5 wraps
+    assert dut.irq_out.value == 1, "IRQ should assert at threshold"
+
+    # Ack restarts the coalescing window
+    await axil_write(axil, STATUS_OFFSET, 0x1)
+    await ClockCycles(dut.clk, 2)
+    assert dut.irq_out.value == 0
+
+
+@cocotb.test
+async def test_coalesce_holdoff_timeout(dut):
+    """COAL_HOLDOFF flushes a partial batch after a timeout"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, COAL_THRESH_OFFSET, 1000)  # never reached
+    await axil_write(axil, COAL_HOLDOFF_OFFSET, 30)
+    await axil_write(axil, PERIOD_OFFSET, 9)
+    await axil_write(axil, CTRL_OFFSET, 0x1)
+
+    await ClockCycles(dut.clk, 15)  # first wrap, holdoff running
+    assert dut.irq_out.value == 0
+
+    await ClockCycles(dut.clk, 35)
+    assert dut.irq_out.value == 1, "IRQ should assert after holdoff expires"
+
+
+async def fifo_push(axil: AxiLiteMaster, period: int, duty: int):
+    await axil_write(axil, FIFO_PERIOD_OFFSET, period)
+    await axil_write(axil, FIFO_DUTY_OFFSET, duty)
+
+
+@cocotb.test
+async def test_fifo_playback_one_entry_per_wrap(dut):
+    """With FIFO_EN each wrap pops one (period, duty) pair into the active registers"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, PERIOD_OFFSET, 40)
+    for period, duty in [(41, 1), (42, 2), (43, 3)]:
+        await fifo_push(axil, period, duty)
+    assert await axil_read(axil, FIFO_LEVEL_OFFSET) == 3
+
+    await axil_write(axil, CTRL_OFFSET, CTRL_EN | CTRL_FIFO_EN)
+    for period, duty in [(41, 1), (42, 2), (43, 3)]:
+        await RisingEdge(dut.wrap_pulse)
+        await ClockCycles(dut.clk, 2)
+        assert dut.period_active.value == period
+        assert dut.duty_active.value == duty
+
+    assert await axil_read(axil, FIFO_LEVEL_OFFSET) == 0
+
+    # Next wrap with an empty FIFO holds the last entry and flags underrun
+    await RisingEdge(dut.wrap_pulse)
+    await ClockCycles(dut.clk, 2)
+    assert dut.period_active.value == 43
+    status = await axil_read(axil, STATUS_OFFSET)
+    assert status & STATUS_FIFO_UNDERRUN, "FIFO_UNDERRUN should be set"
+
+    await axil_write(axil, STATUS_OFFSET, STATUS_FIFO_UNDERRUN)
+    status = await axil_read(axil, STATUS_OFFSET)
+    assert (status & STATUS_FIFO_UNDERRUN) == 0, "FIFO_UNDERRUN should be W1C"
+
+
+@cocotb.test
+async def test_fifo_low_watermark_irq(dut):
+    """FIFO_LOW raises irq_out only while FIFO_IE is set"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, FIFO_WMARK_OFFSET, 1)
+    for _ in range(3):
+        await fifo_push(axil, 20, 10)
+    await axil_write(axil, FIFO_IE_OFFSET, 1)
+    await axil_write(axil, CTRL_OFFSET, CTRL_FIFO_EN)  # playback armed, timer stopped
+    await ClockCycles(dut.clk, 2)
+
+    status = await axil_read(axil, STATUS_OFFSET)
+    assert (status & STATUS_FIFO_LOW) == 0, "3 entries is above watermark 1"
+    assert dut.irq_out.value == 0
+
+    await axil_write(axil, COAL_THRESH_OFFSET, 1000)  # keep STATUS.WRAP quiet
+    await axil_write(axil, CTRL_OFFSET, CTRL_EN | CTRL_FIFO_EN)
+    await ClockCycles(dut.clk, 300)  # default period drains 2 entries
+    status = await axil_read(axil, STATUS_OFFSET)
+    assert status & STATUS_FIFO_LOW, "FIFO_LOW should be set at watermark"
+    assert dut.irq_out.value == 1, "IRQ should assert on FIFO_LOW with FIFO_IE"
+
+    await axil_write(axil, FIFO_IE_OFFSET, 0)
+    await ClockCycles(dut.clk, 2)
+    assert dut.irq_out.value == 0, "FIFO_IE=0 should mask the FIFO IRQ"
+
+
+@cocotb.test
+async def test_group_start_strobe(dut):
+    """An armed timer starts on start_in; GO pulses start_out for one cycle"""
+    clock = Clock(dut.clk, 10, units="ns")
+    cocotb.start_soon(clock.start())
+
+    await reset_dut(dut)
+    axil = mk_axil_master(dut)
+
+    await axil_write(axil, PERIOD_OFFSET, 8)
+    await axil_write(axil, CTRL_OFFSET, CTRL_ARM)
+    await ClockCycles(dut.clk, 20)
+    assert dut.irq_out.value == 0, "armed timer should not run before start_in"
+    ctrl = await axil_read(axil, CTRL_OFFSET)
+    assert ctrl == CTRL_ARM
+
+    # Loop start_out back to start_in, as the block design does for a group
+    async def loopback():
+        while True:
+            await RisingEdge(dut.clk)
+            dut.start_in.value = dut.start_out.value
+
+    cocotb.start_soon(loopback())
+    await axil_write(axil, CTRL_OFFSET, CTRL_ARM | CTRL_GO)
+    await ClockCycles(dut.clk, 3)
+
+    ctrl = await axil_read(axil, CTRL_OFFSET)
+    assert ctrl == CTRL_EN, f"EN should be set and ARM cleared, got {ctrl:#x}"
+    await ClockCycles(dut.clk, 12)
+    assert dut.irq_out.value == 1, "timer should run after group start"
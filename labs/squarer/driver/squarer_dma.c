@@ -5,7 +5,41 @@
 //   write(fd, input_array, n * sizeof(int16_t))  - provide input samples
 //   read(fd, output_array, n * sizeof(int32_t))  - trigger DMA and read results
 //
-// Each read triggers 1 DMA transfer (just a few register writes)
+// Each read() becomes a job on the engine queue; the IRQ handler starts the
+// next transfer as soon as one completes. Jobs up to batch_max_samples are
+// packed with other small jobs into one batch transfer (one MM2S/S2MM pair,
+// one IRQ, TLAST on the final beat) and their results are split back out by
+// offset. Bigger jobs get a transfer of their own, split into chunks only
+// when it exceeds the DMA length register.
+//
+// Each job is real-time or bulk (SQUARER_IOC_SET_CLASS, or the caller's
+// scheduling policy). The engine always serves the RT queue first, and runs
+// bulk transfers in bulk_chunk_samples pieces so that an RT job waits at
+// most one chunk: at each chunk boundary a pending RT transfer preempts the
+// bulk one, which resumes where it left off. Per-class queueing delay
+// histograms are in debugfs (<dev>/queue_delay).
+//
+// Timer-paced ring (SQUARER_IOC_RING_START): the fd's buffer is split into
+// slots and every smart timer wrap IRQ queues the next filled slot as an RT
+// transfer, straight from the timer's interrupt handler. Userspace only
+// fills input slots ahead and reads completed ones.
+//
+// Errors: DMA internal/slave/decode errors raise the error IRQ (and MM2S
+// errors, which only stall S2MM, are caught by a per-chunk watchdog sized
+// from the chunk length). Either way the engine is reset and re-enabled from
+// IRQ context, the chunk is retried once if the error may be transient, and
+// otherwise its jobs fail with -EIO and the queue moves on.
+//
+// Buffers come from a pool: a job takes one input/output pair at write()
+// and gives it back once its read() is done (a timer-paced ring holds one
+// until it stops). Any number of files may be open; with every buffer
+// taken, write() waits for one (or fails with -EAGAIN under O_NONBLOCK).
+// If the caller's own process holds every buffer nobody else can free one,
+// so write() fails with -EBUSY instead of waiting on itself.
+// With a memory-region phandle in the DT node the pool is carved from that
+// reserved-memory / CMA region, split into demo,buffer-count buffers;
+// without one the driver falls back to two 256K-sample buffers from the
+// default CMA area.
 
 #include <linux/module.h>
 #include <linux/platform_device.h>
@@ -14,12 +48,73 @@
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
 #include <linux/uaccess.h>
+#include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
 #include <linux/wait.h>
+#include <linux/bitops.h>
+#include <linux/log2.h>
+#include <linux/of_reserved_mem.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/sched/rt.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/iopoll.h>
+#include <linux/kref.h>
+
+#include "smarttimer_pace.h"
+#include "squarer_uapi.h"
+
+#define CREATE_TRACE_POINTS
+#include "squarer_dma_trace.h"
 
 #define DRV_NAME "squarer_dma"
-#define MAX_SAMPLES (256 * 1024)  // 256K samples: 512KB input, 1MB output
+#define DEFAULT_SAMPLES (256 * 1024)  // per buffer without memory-region
+#define DEFAULT_BUFFERS 2
+#define MAX_BUFFERS     16
+#define DEFAULT_LEN_WIDTH 23          // AXI DMA "Width of Buffer Length Register"
+
+// Small-job batching
+#define BATCH_SLOTS     2             // one filling while one is on the engine
+#define BATCH_SAMPLES   (16 * 1024)   // capacity of one batch transfer
+#define DEFAULT_BATCH_MAX       1024  // jobs up to this many samples are batched
+#define DEFAULT_BATCH_WINDOW_US 20    // idle engine: wait this long for company
+
+// Scheduling
+#define DEFAULT_BULK_CHUNK (16 * 1024)  // ~160 us of streaming at 100 MHz
+
+// Stall watchdog: a chunk streams at ~10 ns/sample; allow 4x plus slack
+#define WD_BASE_NS       (100 * NSEC_PER_USEC)
+#define WD_NS_PER_SAMPLE 40
+#define RESET_TIMEOUT_US 100
+
+enum squarer_class {
+    SQ_RT,
+    SQ_BULK,
+    SQ_NR_CLASSES,
+};
+
+static const char * const squarer_class_names[SQ_NR_CLASSES] = { "rt", "bulk" };
+
+#define MAX_RING_SLOTS 64
+
+// Queueing delay histogram in ns, log2 buckets: bucket i holds [2^i, 2^(i+1))
+#define DELAY_BUCKETS 32
+
+struct sq_delay_hist {
+    u64 count;
+    u64 sum;
+    u32 min;
+    u32 max;
+    u64 bucket[DELAY_BUCKETS];
+};
+
+// One sample needs 2 bytes of input and 4 of output
+#define SAMPLE_BYTES (sizeof(s16) + sizeof(s32))
+// Buffer sizes and chunk lengths are kept multiples of this many samples, so
+// every DMA address stays cache-line aligned (the DMA has no DRE)
+#define SAMPLE_ALIGN 32
 
 // AXI DMA register offsets
 #define MM2S_DMACR   0x00
@@ -32,137 +127,1597 @@
 #define S2MM_LENGTH  0x58
 
 #define DMACR_RS         0x00000001
+#define DMACR_RESET      0x00000004   // resets both channels
 #define DMACR_IOC_IRQ_EN 0x00001000
+#define DMACR_ERR_IRQ_EN 0x00004000
+#define DMASR_HALTED     0x00000001
+#define DMASR_IDLE       0x00000002
+#define DMASR_INT_ERR    0x00000010   // DMAIntErr: e.g. zero length, TLAST mismatch
+#define DMASR_SLV_ERR    0x00000020   // DMASlvErr: slave returned SLVERR
+#define DMASR_DEC_ERR    0x00000040   // DMADecErr: address decodes to nothing
 #define DMASR_IOC_IRQ    0x00001000
+#define DMASR_ERR_IRQ    0x00004000
+#define DMASR_ERRORS     (DMASR_INT_ERR | DMASR_SLV_ERR | DMASR_DEC_ERR)
+
+// One input/output pair, a single coherent allocation (input first)
+struct squarer_buf {
+    s16 *input;
+    dma_addr_t input_dma;
+    s32 *output;
+    dma_addr_t output_dma;
+    pid_t owner;              // tgid of the process holding it
+};
+
+struct squarer_batch;
+struct squarer_ring;
+
+// One DMA transfer on the engine queue: a contiguous input/output range
+// serving one job (solo) or several (batch)
+struct squarer_xfer {
+    struct list_head node;      // dev->queue
+    struct list_head jobs;      // squarer_job.node, not yet completed
+    dma_addr_t input_dma;
+    dma_addr_t output_dma;
+    size_t count;
+    size_t done;                // samples finished (chunked transfers)
+    enum squarer_class cls;     // queue it waits in (RT if any job is RT)
+    struct squarer_batch *batch;  // NULL for a solo transfer
+    struct squarer_ring *ring;  // set for a ring slot (no jobs attached)
+    u32 id;                     // trace: new for each fill, submit or kick
+};
+
+// Staging buffer for small jobs, filled in submit order
+struct squarer_batch {
+    struct squarer_buf buf;
+    struct squarer_xfer xfer;
+    size_t count;               // samples staged
+    unsigned int jobs;          // jobs packed in
+    unsigned int users;         // jobs that have not copied their results out
+    unsigned int copying;       // writers still copying input into their range
+    bool sealed;                // flushed while copying: the last copier queues it
+    bool busy;                  // filling, queued, in flight or being read
+    bool in_flight;             // queued or on the engine
+};
+
+// One write()/read() pair: where its results land and how it ended
+struct squarer_job {
+    struct list_head node;      // squarer_xfer.jobs
+    struct squarer_batch *batch;  // NULL for a solo job
+    const s32 *output;
+    size_t count;
+    enum squarer_class cls;
+    u64 t_submit;               // ktime_get_ns() at submit (write() if batched)
+    u32 xfer_id;                // trace: id of the transfer carrying it
+    int status;
+    bool done;
+};
 
 struct squarer_dma_dev {
     void __iomem *dma_base;
     struct miscdevice misc;
-    struct mutex lock;
+    struct kref ref;            // probe's, plus one per open file
+    struct mutex files_lock;
+    struct list_head files;     // open files, for remove
 
-    // DMA coherent buffers
-    s16 *input_buf;
-    dma_addr_t input_dma;
-    s32 *output_buf;
-    dma_addr_t output_dma;
+    // Buffer pool
+    struct squarer_buf bufs[MAX_BUFFERS];
+    unsigned int nbufs;
+    size_t buf_samples;         // capacity of each buffer
+    unsigned long buf_used;     // bitmap, protected by pool_lock
+    spinlock_t pool_lock;
+    wait_queue_head_t pool_wait;  // write() waiting for a free buffer
+
+    // Engine: one transfer in flight, the rest queued. lock is also taken
+    // by the IRQ handler and the batch timer.
+    spinlock_t lock;
+    struct list_head queue[SQ_NR_CLASSES];
+    struct squarer_xfer *active;
+    size_t active_n;            // samples in the chunk on the engine
+    u32 active_id;              // trace: id of the transfer on the engine
+    u32 next_id;
+    size_t max_chunk;           // samples per DMA transfer
+    u32 bulk_chunk;             // sysfs bulk_chunk_samples, 0 = max_chunk
+    wait_queue_head_t wait;     // job completion
+
+    // Error recovery, under lock
+    struct hrtimer wd_timer;    // stall watchdog for the chunk on the engine
+    ktime_t chunk_deadline;
+    bool retried;               // the active chunk already had its retry
+    u32 last_mm2s_sr;           // DMASR of both channels at the last error
+    u32 last_s2mm_sr;
+    u64 stat_errors;            // internal/slave/decode errors, either channel
+    u64 stat_stalls;            // watchdog expiries without an error bit
+    u64 stat_resets;
+    u64 stat_retries;
+    bool halted;                // removed: the engine stays in reset
+
+    // Scheduling statistics, under lock
+    struct sq_delay_hist delay[SQ_NR_CLASSES];  // submit -> first chunk start
+    u64 stat_preemptions;
+    u64 stat_pace_kicks;        // ring slots started by a timer wrap
+    u64 stat_pace_starved;      // wraps that found no filled slot
+    u64 stat_pace_dropped;      // extra wraps in one IRQ, not made up for
+    struct dentry *dbg_dir;
 
+    // Small-job batching
+    struct squarer_batch batches[BATCH_SLOTS];
+    struct squarer_batch *fill; // accepting jobs, or NULL
+    struct hrtimer batch_timer;
+    u32 batch_max;              // sysfs batch_max_samples, 0 = off
+    u32 batch_window_us;
+    u64 stat_batches;
+    u64 stat_batched_jobs;
+};
+
+// Timer-paced ring over one file's buffer. Slot indices are free-running:
+// tail <= kick <= head, head - tail <= slots. Under dev->lock.
+struct squarer_ring {
+    struct squarer_dma_dev *dev;
+    struct notifier_block nb;
+    void (*unregister)(int id, struct notifier_block *nb);  // pins smarttimer
+    int timer;
+    u32 slots;
+    u32 samples;
+    u32 head;                   // next slot write() fills
+    u32 kick;                   // next slot a wrap starts
+    u32 tail;                   // next slot read() returns
+    int status[MAX_RING_SLOTS];
+    bool done[MAX_RING_SLOTS];
+    struct squarer_xfer xfer[MAX_RING_SLOTS];
+};
+
+// Per open file: the staged job (its pool buffer and sample count) and the
+// transfer/job used by its read()
+struct squarer_file {
+    struct squarer_dma_dev *dev;
+    struct list_head node;      // on dev->files
+    struct squarer_buf *buf;    // held from write() to the end of read()
+    struct mutex lock;
     size_t count;
-    bool transfer_done;
-    wait_queue_head_t wait;
+    u32 cls_mode;               // SQUARER_CLASS_*
+    struct squarer_ring *ring;  // timer-paced mode, or NULL
+    struct squarer_xfer xfer;
+    struct squarer_job job;
 };
 
+static void start_dma_transfer(struct squarer_dma_dev *dev, dma_addr_t src,
+                               dma_addr_t dst, size_t count)
+{
+    u32 in_bytes = count * sizeof(s16);
+    u32 out_bytes = count * sizeof(s32);
+
+    // MM2S: memory -> squarer (16-bit input)
+    writel((u32)src, dev->dma_base + MM2S_SA);
+    writel(in_bytes, dev->dma_base + MM2S_LENGTH);
+
+    // S2MM: squarer -> memory (32-bit output)
+    writel((u32)dst, dev->dma_base + S2MM_DA);
+    writel(out_bytes, dev->dma_base + S2MM_LENGTH);
+
+    trace_squarer_dma_start(dev->active_id, count);
+}
+
+static void sq_delay_reset(struct sq_delay_hist *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = U32_MAX;
+}
+
+static void sq_delay_record(struct sq_delay_hist *h, u64 ns)
+{
+    u32 v = min_t(u64, ns, U32_MAX);
+    int b = v ? fls(v) - 1 : 0;
+
+    h->count++;
+    h->sum += v;
+    if (v < h->min)
+        h->min = v;
+    if (v > h->max)
+        h->max = v;
+    h->bucket[b]++;
+}
+
+// ---------- engine (all with dev->lock held) ----------
+
+// Program the next chunk of the active transfer. Bulk transfers go in
+// bulk_chunk pieces so RT work can get in between.
+static void squarer_start_chunk(struct squarer_dma_dev *dev)
+{
+    struct squarer_xfer *x = dev->active;
+    size_t chunk = dev->max_chunk;
+    u64 timeout;
+
+    if (x->cls == SQ_BULK && dev->bulk_chunk)
+        chunk = min_t(size_t, chunk, dev->bulk_chunk);
+
+    if (x->done == 0 && !dev->retried) {
+        struct squarer_job *job;
+        u64 now = ktime_get_ns();
+
+        list_for_each_entry(job, &x->jobs, node)
+            sq_delay_record(&dev->delay[job->cls], now - job->t_submit);
+    }
+
+    dev->active_n = min(x->count - x->done, chunk);
+    dev->active_id = x->id;
+    start_dma_transfer(dev, x->input_dma + x->done * sizeof(s16),
+                       x->output_dma + x->done * sizeof(s32), dev->active_n);
+
+    timeout = WD_BASE_NS + (u64)dev->active_n * WD_NS_PER_SAMPLE;
+    dev->chunk_deadline = ktime_add_ns(ktime_get(), timeout);
+    hrtimer_start(&dev->wd_timer, ns_to_ktime(timeout), HRTIMER_MODE_REL);
+}
+
+static void squarer_complete(struct squarer_dma_dev *dev,
+                             struct squarer_xfer *x, int status);
+
+// Start the head of the highest-priority non-empty queue if the engine is
+// idle. Once the device is removed, everything queued fails instead.
+static void squarer_start_next(struct squarer_dma_dev *dev)
+{
+    struct squarer_xfer *x, *tmp;
+    int c;
+
+    if (dev->active)
+        return;
+
+    if (dev->halted) {
+        for (c = 0; c < SQ_NR_CLASSES; c++) {
+            list_for_each_entry_safe(x, tmp, &dev->queue[c], node) {
+                list_del_init(&x->node);
+                squarer_complete(dev, x, -ENODEV);
+            }
+        }
+        return;
+    }
+
+    for (c = 0; c < SQ_NR_CLASSES; c++) {
+        if (list_empty(&dev->queue[c]))
+            continue;
+        dev->active = list_first_entry(&dev->queue[c], struct squarer_xfer, node);
+        list_del_init(&dev->active->node);
+        dev->retried = false;
+        squarer_start_chunk(dev);
+        return;
+    }
+}
+
+static void squarer_batch_free(struct squarer_dma_dev *dev,
+                               struct squarer_batch *b)
+{
+    if (dev->fill == b)
+        dev->fill = NULL;
+    b->busy = false;
+}
+
+// Finish every job still attached to x with status and wake the waiters
+static void squarer_complete(struct squarer_dma_dev *dev,
+                             struct squarer_xfer *x, int status)
+{
+    struct squarer_job *job, *tmp;
+
+    list_for_each_entry_safe(job, tmp, &x->jobs, node) {
+        list_del_init(&job->node);
+        job->status = status;
+        job->done = true;
+    }
+    if (x->ring) {
+        unsigned int i = x - x->ring->xfer;
+
+        x->ring->status[i] = status;
+        x->ring->done[i] = true;
+    }
+    if (x->batch) {
+        x->batch->in_flight = false;
+        if (x->batch->users == 0)
+            squarer_batch_free(dev, x->batch);
+    }
+    wake_up_all(&dev->wait);
+}
+
+static void squarer_queue_batch(struct squarer_dma_dev *dev,
+                                struct squarer_batch *b)
+{
+    b->xfer.count = b->count;
+    b->xfer.done = 0;
+    b->in_flight = true;
+    list_add_tail(&b->xfer.node, &dev->queue[b->xfer.cls]);
+
+    dev->stat_batches++;
+    dev->stat_batched_jobs += b->jobs;
+    trace_squarer_dma_batch(b->jobs, b->count);
+    squarer_start_next(dev);
+}
+
+// Hand the filling batch to the engine. Writers still copying into it keep
+// it off the queue; the last one to finish queues it.
+static void squarer_flush(struct squarer_dma_dev *dev)
+{
+    struct squarer_batch *b = dev->fill;
+
+    if (!b)
+        return;
+    dev->fill = NULL;
+    hrtimer_try_to_cancel(&dev->batch_timer);
+
+    if (b->copying)
+        b->sealed = true;
+    else
+        squarer_queue_batch(dev, b);
+}
+
+// The filling batch if count still fits, else a fresh one (flushing the
+// full one). NULL when every slot is busy: the job then goes solo.
+static struct squarer_batch *squarer_batch_get(struct squarer_dma_dev *dev,
+                                               size_t count)
+{
+    struct squarer_batch *b = dev->fill;
+    int i;
+
+    if (b && b->count + count <= BATCH_SAMPLES)
+        return b;
+    squarer_flush(dev);
+
+    for (i = 0; i < BATCH_SLOTS; i++) {
+        b = &dev->batches[i];
+        if (b->busy)
+            continue;
+        b->busy = true;
+        b->count = 0;
+        b->jobs = 0;
+        b->users = 0;
+        b->copying = 0;
+        b->sealed = false;
+        b->xfer.cls = SQ_BULK;
+        b->xfer.id = ++dev->next_id;
+        INIT_LIST_HEAD(&b->xfer.jobs);
+        dev->fill = b;
+        return b;
+    }
+    return NULL;
+}
+
+static enum hrtimer_restart squarer_batch_timeout(struct hrtimer *t)
+{
+    struct squarer_dma_dev *dev = container_of(t, struct squarer_dma_dev,
+                                               batch_timer);
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    squarer_flush(dev);
+    spin_unlock_irqrestore(&dev->lock, flags);
+    return HRTIMER_NORESTART;
+}
+
+// Drop a batch job's reference once its results are copied out
+static void squarer_batch_put(struct squarer_dma_dev *dev,
+                              struct squarer_batch *b)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    if (--b->users == 0 && !b->in_flight)
+        squarer_batch_free(dev, b);
+    spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+static void squarer_dma_enable(struct squarer_dma_dev *dev)
+{
+    u32 cr = DMACR_RS | DMACR_IOC_IRQ_EN | DMACR_ERR_IRQ_EN;
+
+    writel(cr, dev->dma_base + MM2S_DMACR);
+    writel(cr, dev->dma_base + S2MM_DMACR);
+}
+
+// Soft-reset the AXI DMA (clears halted/error state) and start it again,
+// unless the device is being removed. Safe from IRQ context: the reset
+// completes in a few clocks.
+static void squarer_dma_reset(struct squarer_dma_dev *dev)
+{
+    u32 cr;
+
+    writel(DMACR_RESET, dev->dma_base + MM2S_DMACR);
+    if (readl_poll_timeout_atomic(dev->dma_base + MM2S_DMACR, cr,
+                                  !(cr & DMACR_RESET), 1, RESET_TIMEOUT_US))
+        dev_err_ratelimited(dev->misc.this_device, "DMA reset timed out\n");
+    if (!dev->halted)
+        squarer_dma_enable(dev);
+    dev->stat_resets++;
+}
+
+// Stop the engine mid-transfer and fail whatever it was running
+static void squarer_abort_active(struct squarer_dma_dev *dev, int status)
+{
+    struct squarer_xfer *x = dev->active;
+
+    dev->active = NULL;
+    squarer_dma_reset(dev);
+    if (x)
+        squarer_complete(dev, x, status);
+    squarer_flush(dev);
+    squarer_start_next(dev);
+}
+
+// The engine reported an error or stopped making progress. A stall or a
+// slave error may be transient, so the chunk gets one retry; decode and
+// internal errors would just repeat. Called under lock.
+static void squarer_recover(struct squarer_dma_dev *dev, u32 mm2s_sr,
+                            u32 s2mm_sr)
+{
+    u32 err = (mm2s_sr | s2mm_sr) & DMASR_ERRORS;
+
+    dev->last_mm2s_sr = mm2s_sr;
+    dev->last_s2mm_sr = s2mm_sr;
+    if (err)
+        dev->stat_errors++;
+    else
+        dev->stat_stalls++;
+    trace_squarer_dma_error(mm2s_sr, s2mm_sr);
+    dev_err_ratelimited(dev->misc.this_device,
+                        "DMA %s: mm2s_sr 0x%08x s2mm_sr 0x%08x%s%s%s%s\n",
+                        err ? "error" : "stalled", mm2s_sr, s2mm_sr,
+                        (mm2s_sr | s2mm_sr) & DMASR_INT_ERR ? " internal" : "",
+                        (mm2s_sr | s2mm_sr) & DMASR_SLV_ERR ? " slave" : "",
+                        (mm2s_sr | s2mm_sr) & DMASR_DEC_ERR ? " decode" : "",
+                        (mm2s_sr | s2mm_sr) & DMASR_HALTED ? " halted" : "");
+
+    if (dev->active && !dev->retried && !(err & ~DMASR_SLV_ERR)) {
+        squarer_dma_reset(dev);
+        dev->retried = true;
+        dev->stat_retries++;
+        squarer_start_chunk(dev);
+    } else {
+        squarer_abort_active(dev, -EIO);
+    }
+}
+
+static enum hrtimer_restart squarer_wd_timeout(struct hrtimer *t)
+{
+    struct squarer_dma_dev *dev = container_of(t, struct squarer_dma_dev,
+                                               wd_timer);
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    // The chunk may have completed (and a new one started) meanwhile
+    if (dev->active && ktime_compare(ktime_get(), dev->chunk_deadline) >= 0)
+        squarer_recover(dev, readl(dev->dma_base + MM2S_DMASR),
+                        readl(dev->dma_base + S2MM_DMASR));
+    spin_unlock_irqrestore(&dev->lock, flags);
+    return HRTIMER_NORESTART;
+}
+
 static irqreturn_t squarer_dma_irq(int irq, void *data)
 {
     struct squarer_dma_dev *dev = data;
+    u32 mm2s_sr = readl(dev->dma_base + MM2S_DMASR);
     u32 status = readl(dev->dma_base + S2MM_DMASR);
+    struct squarer_xfer *x;
 
-    if (!(status & DMASR_IOC_IRQ))
+    if (!((mm2s_sr | status) & (DMASR_IOC_IRQ | DMASR_ERR_IRQ)))
         return IRQ_NONE;
 
-    // Clear interrupt
+    trace_squarer_dma_irq(READ_ONCE(dev->active_id), status);
+
+    if ((mm2s_sr | status) & DMASR_ERR_IRQ) {
+        spin_lock(&dev->lock);
+        hrtimer_try_to_cancel(&dev->wd_timer);
+        squarer_recover(dev, mm2s_sr, status);  // the reset clears DMASR
+        spin_unlock(&dev->lock);
+        return IRQ_HANDLED;
+    }
+
+    // Clear interrupt (MM2S IOC only fires with mm2s_introut wired)
+    if (mm2s_sr & DMASR_IOC_IRQ)
+        writel(DMASR_IOC_IRQ, dev->dma_base + MM2S_DMASR);
+    if (!(status & DMASR_IOC_IRQ))
+        return IRQ_HANDLED;
     writel(DMASR_IOC_IRQ, dev->dma_base + S2MM_DMASR);
 
-    dev->transfer_done = true;
-    wake_up_interruptible(&dev->wait);
+    spin_lock(&dev->lock);
+    hrtimer_try_to_cancel(&dev->wd_timer);
+    x = dev->active;
+    if (x) {
+        x->done += dev->active_n;
+        dev->retried = false;
+        if (x->done < x->count && x->cls == SQ_BULK &&
+            !list_empty(&dev->queue[SQ_RT])) {
+            // Chunk boundary: park the bulk transfer at the head of its queue
+            list_add(&x->node, &dev->queue[SQ_BULK]);
+            dev->active = NULL;
+            dev->stat_preemptions++;
+            squarer_start_next(dev);
+        } else if (x->done < x->count) {
+            squarer_start_chunk(dev);
+        } else {
+            dev->active = NULL;
+            squarer_complete(dev, x, 0);
+            // Small jobs that arrived while the engine was busy go out now
+            squarer_flush(dev);
+            squarer_start_next(dev);
+        }
+    }
+    spin_unlock(&dev->lock);
     return IRQ_HANDLED;
 }
 
-static void start_dma_transfer(struct squarer_dma_dev *dev, size_t count)
+// ---------- buffer pool ----------
+
+static bool squarer_buf_free(struct squarer_dma_dev *dev)
 {
-    u32 in_bytes = count * sizeof(s16);
-    u32 out_bytes = count * sizeof(s32);
+    return find_first_zero_bit(&dev->buf_used, dev->nbufs) < dev->nbufs;
+}
 
-    dev->transfer_done = false;
+// Every buffer is held by the calling process. Caller holds pool_lock.
+static bool squarer_buf_all_mine(struct squarer_dma_dev *dev)
+{
+    unsigned int i;
 
-    // MM2S: memory -> squarer (16-bit input)
-    writel((u32)dev->input_dma, dev->dma_base + MM2S_SA);
-    writel(in_bytes, dev->dma_base + MM2S_LENGTH);
+    for (i = 0; i < dev->nbufs; i++)
+        if (dev->bufs[i].owner != current->tgid)
+            return false;
+    return true;
+}
 
-    // S2MM: squarer -> memory (32-bit output)
-    writel((u32)dev->output_dma, dev->dma_base + S2MM_DA);
-    writel(out_bytes, dev->dma_base + S2MM_LENGTH);
+// Take a pool buffer for f, waiting for one unless nonblock
+static int squarer_buf_get(struct squarer_file *f, bool nonblock)
+{
+    struct squarer_dma_dev *dev = f->dev;
+    unsigned int i;
+    int ret;
+
+    while (!f->buf) {
+        bool mine = false;
+
+        if (READ_ONCE(dev->halted))
+            return -ENODEV;
+        spin_lock(&dev->pool_lock);
+        i = find_first_zero_bit(&dev->buf_used, dev->nbufs);
+        if (i < dev->nbufs) {
+            __set_bit(i, &dev->buf_used);
+            f->buf = &dev->bufs[i];
+            f->buf->owner = current->tgid;
+        } else {
+            mine = squarer_buf_all_mine(dev);
+        }
+        spin_unlock(&dev->pool_lock);
+        if (f->buf)
+            break;
+
+        // Only this process could give one back: waiting would never end
+        if (mine)
+            return -EBUSY;
+        if (nonblock)
+            return -EAGAIN;
+        ret = wait_event_interruptible(dev->pool_wait, squarer_buf_free(dev) ||
+                                       READ_ONCE(dev->halted));
+        if (ret)
+            return ret;
+    }
+    return 0;
 }
 
-static ssize_t squarer_write(struct file *file, const char __user *buf,
-                             size_t len, loff_t *off)
+// Return f's buffer to the pool. Its transfer must be finished or abandoned.
+static void squarer_buf_put(struct squarer_file *f)
+{
+    struct squarer_dma_dev *dev = f->dev;
+
+    if (!f->buf)
+        return;
+    spin_lock(&dev->pool_lock);
+    __clear_bit(f->buf - dev->bufs, &dev->buf_used);
+    f->buf->owner = 0;
+    spin_unlock(&dev->pool_lock);
+    f->buf = NULL;
+    f->count = 0;
+    wake_up_interruptible(&dev->pool_wait);
+}
+
+// Forget the job staged by write(), e.g. when it is overwritten before its
+// read(). A batched job leaves its batch; the samples are processed anyway.
+static void squarer_unstage(struct squarer_file *f)
+{
+    struct squarer_dma_dev *dev = f->dev;
+    struct squarer_job *job = &f->job;
+    unsigned long flags;
+
+    if (job->batch) {
+        spin_lock_irqsave(&dev->lock, flags);
+        list_del_init(&job->node);
+        spin_unlock_irqrestore(&dev->lock, flags);
+        squarer_batch_put(dev, job->batch);
+        job->batch = NULL;
+    }
+    f->count = 0;
+}
+
+// ---------- timer-paced ring ----------
+
+// Smart timer wrap (hard IRQ of the timer): start the next filled slot. A
+// coalesced or late IRQ reports several wraps, but still starts one slot:
+// releasing the backlog at once would send a burst of slots back-to-back,
+// off the timer's pace. The missed wraps are only counted.
+static int squarer_ring_wrap(struct notifier_block *nb, unsigned long wraps,
+                             void *data)
+{
+    struct squarer_ring *r = container_of(nb, struct squarer_ring, nb);
+    struct squarer_dma_dev *dev = r->dev;
+    struct squarer_xfer *x;
+    unsigned long flags;
+
+    if (!wraps)
+        return NOTIFY_DONE;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    dev->stat_pace_dropped += wraps - 1;
+    if (r->kick == r->head) {
+        dev->stat_pace_starved++;
+    } else {
+        x = &r->xfer[r->kick % r->slots];
+        x->id = ++dev->next_id;
+        x->done = 0;
+        r->done[r->kick % r->slots] = false;
+        list_add_tail(&x->node, &dev->queue[SQ_RT]);
+        r->kick++;
+        dev->stat_pace_kicks++;
+    }
+    squarer_start_next(dev);
+    spin_unlock_irqrestore(&dev->lock, flags);
+    return NOTIFY_OK;
+}
+
+static int squarer_ring_start(struct squarer_file *f,
+                              const struct squarer_ring_config *cfg,
+                              bool nonblock)
+{
+    struct squarer_dma_dev *dev = f->dev;
+    int (*reg)(int id, struct notifier_block *nb);
+    struct squarer_ring *r;
+    unsigned int i;
+    int ret;
+
+    if (dev->halted)
+        return -ENODEV;
+    if (f->ring)
+        return -EBUSY;
+    // Slot addresses are multiples of samples, so it must keep them aligned
+    if (cfg->slots < 2 || cfg->slots > MAX_RING_SLOTS || !cfg->samples ||
+        !IS_ALIGNED(cfg->samples, SAMPLE_ALIGN) ||
+        (size_t)cfg->slots * cfg->samples > dev->buf_samples)
+        return -EINVAL;
+    squarer_unstage(f);  // any one-shot input staged before is dropped
+    ret = squarer_buf_get(f, nonblock);
+    if (ret)
+        return ret;
+
+    r = kzalloc(sizeof(*r), GFP_KERNEL);
+    if (!r) {
+        squarer_buf_put(f);
+        return -ENOMEM;
+    }
+    r->dev = dev;
+    r->timer = cfg->timer;
+    r->slots = cfg->slots;
+    r->samples = cfg->samples;
+    r->nb.notifier_call = squarer_ring_wrap;
+    for (i = 0; i < r->slots; i++) {
+        struct squarer_xfer *x = &r->xfer[i];
+
+        INIT_LIST_HEAD(&x->node);
+        INIT_LIST_HEAD(&x->jobs);
+        x->input_dma = f->buf->input_dma + i * r->samples * sizeof(s16);
+        x->output_dma = f->buf->output_dma + i * r->samples * sizeof(s32);
+        x->count = r->samples;
+        x->cls = SQ_RT;
+        x->ring = r;
+    }
+
+    // Bind to smarttimer_blocking at run time; holding the unregister
+    // symbol keeps that module loaded while the ring runs
+    r->unregister = symbol_get(smarttimer_wrap_notifier_unregister);
+    reg = symbol_get(smarttimer_wrap_notifier_register);
+    if (!r->unregister || !reg) {
+        ret = -ENODEV;
+        goto err;
+    }
+    f->ring = r;
+    ret = reg(r->timer, &r->nb);
+    symbol_put(smarttimer_wrap_notifier_register);
+    reg = NULL;
+    if (ret) {
+        f->ring = NULL;
+        goto err;
+    }
+    return 0;
+
+err:
+    if (reg)
+        symbol_put(smarttimer_wrap_notifier_register);
+    if (r->unregister)
+        symbol_put(smarttimer_wrap_notifier_unregister);
+    kfree(r);
+    squarer_buf_put(f);
+    return ret;
+}
+
+static bool squarer_ring_busy(struct squarer_dma_dev *dev, struct squarer_ring *r)
+{
+    bool busy;
+
+    spin_lock_irq(&dev->lock);
+    busy = dev->active && dev->active->ring == r;
+    spin_unlock_irq(&dev->lock);
+    return busy;
+}
+
+// Detach from the timer, drop queued slots and let an in-flight one finish
+static void squarer_ring_stop(struct squarer_file *f)
+{
+    struct squarer_dma_dev *dev = f->dev;
+    struct squarer_ring *r = f->ring;
+    unsigned int i;
+
+    if (!r)
+        return;
+
+    r->unregister(r->timer, &r->nb);  // no wrap callback runs after this
+    symbol_put(smarttimer_wrap_notifier_unregister);
+
+    spin_lock_irq(&dev->lock);
+    for (i = 0; i < r->slots; i++)
+        list_del_init(&r->xfer[i].node);
+    spin_unlock_irq(&dev->lock);
+
+    if (!wait_event_timeout(dev->wait, !squarer_ring_busy(dev, r),
+                            msecs_to_jiffies(1000))) {
+        spin_lock_irq(&dev->lock);
+        if (dev->active && dev->active->ring == r) {
+            hrtimer_try_to_cancel(&dev->wd_timer);
+            squarer_abort_active(dev, -ETIMEDOUT);
+        }
+        spin_unlock_irq(&dev->lock);
+    }
+
+    f->ring = NULL;
+    kfree(r);
+    squarer_buf_put(f);
+}
+
+// Queue one slot of input; it starts on a later timer wrap. Only read()
+// frees slots and both run under f->lock, so a full ring fails instead of
+// blocking.
+static ssize_t squarer_ring_write(struct squarer_file *f, const char __user *buf,
+                                  size_t len)
+{
+    struct squarer_dma_dev *dev = f->dev;
+    struct squarer_ring *r = f->ring;
+    unsigned int slot;
+
+    if (len != r->samples * sizeof(s16))
+        return -EINVAL;
+    if (r->head - r->tail >= r->slots)
+        return -ENOSPC;
+
+    slot = r->head % r->slots;
+    if (copy_from_user(f->buf->input + slot * r->samples, buf, len))
+        return -EFAULT;
+
+    spin_lock_irq(&dev->lock);
+    r->head++;  // publish: a wrap may start it from now on
+    spin_unlock_irq(&dev->lock);
+    return len;
+}
+
+// Return the oldest queued slot once a wrap has started and completed it
+static ssize_t squarer_ring_read(struct squarer_file *f, char __user *buf,
+                                 size_t len, bool nonblock)
+{
+    struct squarer_dma_dev *dev = f->dev;
+    struct squarer_ring *r = f->ring;
+    size_t out_bytes = r->samples * sizeof(s32);
+    unsigned int slot = r->tail % r->slots;
+    int ret;
+
+    if (len < out_bytes)
+        return -EINVAL;
+    if (r->head == r->tail)
+        return 0;  // nothing queued, as for an empty one-shot read
+
+    if (!(READ_ONCE(r->kick) != r->tail && READ_ONCE(r->done[slot]))) {
+        if (nonblock)
+            return -EAGAIN;
+        ret = wait_event_interruptible(dev->wait,
+                    (READ_ONCE(r->kick) != r->tail && READ_ONCE(r->done[slot])) ||
+                    READ_ONCE(dev->halted));
+        if (ret)
+            return ret;
+        if (dev->halted)
+            return -ENODEV;
+    }
+
+    ret = r->status[slot];
+    if (!ret && copy_to_user(buf, f->buf->output + slot * r->samples, out_bytes))
+        ret = -EFAULT;
+
+    spin_lock_irq(&dev->lock);
+    r->done[slot] = false;
+    r->tail++;
+    spin_unlock_irq(&dev->lock);
+    return ret ? ret : out_bytes;
+}
+
+// ---------- jobs ----------
+
+static enum squarer_class squarer_job_class(struct squarer_file *f)
+{
+    switch (READ_ONCE(f->cls_mode)) {
+    case SQUARER_CLASS_RT:
+        return SQ_RT;
+    case SQUARER_CLASS_BULK:
+        return SQ_BULK;
+    default:
+        return rt_task(current) ? SQ_RT : SQ_BULK;
+    }
+}
+
+// Start f's staged solo job: count samples from its pool buffer
+static void squarer_submit(struct squarer_dma_dev *dev, struct squarer_file *f,
+                           size_t count)
+{
+    struct squarer_job *job = &f->job;
+    struct squarer_xfer *x = &f->xfer;
+    unsigned long flags;
+
+    job->count = count;
+    job->cls = squarer_job_class(f);
+    job->t_submit = ktime_get_ns();
+    job->status = 0;
+    job->done = false;
+    job->batch = NULL;
+    job->output = f->buf->output;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    x->input_dma = f->buf->input_dma;
+    x->output_dma = f->buf->output_dma;
+    x->count = count;
+    x->done = 0;
+    x->cls = job->cls;
+    x->id = ++dev->next_id;
+    job->xfer_id = x->id;
+    trace_squarer_dma_submit(x->id, count);
+    list_add_tail(&job->node, &x->jobs);
+    list_add_tail(&x->node, &dev->queue[x->cls]);
+    squarer_start_next(dev);
+    spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+// Stage a small job straight into the filling batch: reserve its range
+// under the lock, then copy from userspace into it without the lock. The
+// batch goes to the engine when full, when the engine finishes its current
+// transfer, or batch_window_us after the first job found it idle; an RT job
+// sends it right away. Returns -ENOSPC if every batch slot is busy (the job
+// then goes solo).
+static int squarer_stage_batch(struct squarer_dma_dev *dev,
+                               struct squarer_file *f,
+                               const char __user *ubuf, size_t count)
+{
+    struct squarer_job *job = &f->job;
+    struct squarer_batch *b;
+    unsigned long flags;
+    s16 *input;
+    int ret = 0;
+
+    job->count = count;
+    job->cls = squarer_job_class(f);
+    job->t_submit = ktime_get_ns();
+    job->status = 0;
+    job->done = false;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    b = squarer_batch_get(dev, count);
+    if (!b) {
+        spin_unlock_irqrestore(&dev->lock, flags);
+        return -ENOSPC;
+    }
+    input = b->buf.input + b->count;
+    job->batch = b;
+    job->xfer_id = b->xfer.id;
+    trace_squarer_dma_submit(b->xfer.id, count);
+    job->output = b->buf.output + b->count;
+    list_add_tail(&job->node, &b->xfer.jobs);
+    b->count += count;
+    b->jobs++;
+    b->users++;
+    b->copying++;
+    if (job->cls == SQ_RT)
+        b->xfer.cls = SQ_RT;
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    if (copy_from_user(input, ubuf, count * sizeof(s16)))
+        ret = -EFAULT;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    if (ret) {
+        list_del_init(&job->node);
+        job->status = ret;
+        job->done = true;
+    }
+    if (--b->copying == 0 && b->sealed) {
+        b->sealed = false;
+        squarer_queue_batch(dev, b);
+    } else if (b == dev->fill) {
+        if (b->count + dev->batch_max > BATCH_SAMPLES || job->cls == SQ_RT ||
+            (!dev->active && !dev->batch_window_us))
+            squarer_flush(dev);
+        else if (!dev->active && !hrtimer_active(&dev->batch_timer))
+            hrtimer_start(&dev->batch_timer,
+                          us_to_ktime(dev->batch_window_us), HRTIMER_MODE_REL);
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    if (ret) {
+        squarer_batch_put(dev, b);
+        job->batch = NULL;
+    }
+    return ret;
+}
+
+// The wait for f's job ended early with err (timeout or signal). A timed
+// out transfer on the engine is abandoned along with every job on it, as
+// is the caller's own solo transfer; otherwise the job just leaves its
+// transfer. Returns 0 if the job completed in the meantime.
+static int squarer_cancel(struct squarer_dma_dev *dev, struct squarer_file *f,
+                          int err)
+{
+    struct squarer_job *job = &f->job;
+    struct squarer_xfer *x = job->batch ? &job->batch->xfer : &f->xfer;
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->lock, flags);
+    if (!job->done) {
+        if (dev->active == x && (err == -ETIMEDOUT || !job->batch)) {
+            hrtimer_try_to_cancel(&dev->wd_timer);
+            squarer_abort_active(dev, err);
+        } else {
+            list_del_init(&job->node);
+            if (!job->batch)
+                list_del_init(&x->node);
+            job->status = err;
+            job->done = true;
+        }
+    }
+    spin_unlock_irqrestore(&dev->lock, flags);
+    return job->status;
+}
+
+// ---------- file operations ----------
+
+// Open files keep dev (not its registers or buffers) alive past remove
+static void squarer_dev_release(struct kref *ref)
+{
+    kfree(container_of(ref, struct squarer_dma_dev, ref));
+}
+
+static void squarer_dev_put(void *data)
+{
+    struct squarer_dma_dev *dev = data;
+
+    kref_put(&dev->ref, squarer_dev_release);
+}
+
+// Drop everything f holds on the device: its ring, staged job and buffer.
+// Caller holds f->lock or is the last user of f.
+static void squarer_file_detach(struct squarer_file *f)
+{
+    squarer_ring_stop(f);
+    squarer_unstage(f);
+    squarer_buf_put(f);
+}
+
+static int squarer_open(struct inode *inode, struct file *file)
 {
     struct squarer_dma_dev *dev = container_of(file->private_data,
                                     struct squarer_dma_dev, misc);
+    struct squarer_file *f;
+
+    f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return -ENOMEM;
+
+    f->dev = dev;
+    mutex_init(&f->lock);
+    INIT_LIST_HEAD(&f->xfer.node);
+    INIT_LIST_HEAD(&f->xfer.jobs);
+    INIT_LIST_HEAD(&f->job.node);
+
+    mutex_lock(&dev->files_lock);
+    if (dev->halted) {
+        mutex_unlock(&dev->files_lock);
+        kfree(f);
+        return -ENODEV;
+    }
+    list_add(&f->node, &dev->files);
+    kref_get(&dev->ref);
+    mutex_unlock(&dev->files_lock);
+
+    file->private_data = f;
+    return 0;
+}
+
+static int squarer_release(struct inode *inode, struct file *file)
+{
+    struct squarer_file *f = file->private_data;
+    struct squarer_dma_dev *dev = f->dev;
+
+    // Under files_lock so remove never detaches f at the same time
+    mutex_lock(&dev->files_lock);
+    list_del(&f->node);
+    squarer_file_detach(f);
+    mutex_unlock(&dev->files_lock);
+
+    kfree(f);
+    squarer_dev_put(dev);
+    return 0;
+}
+
+static ssize_t squarer_write(struct file *file, const char __user *buf,
+                             size_t len, loff_t *off)
+{
+    struct squarer_file *f = file->private_data;
     size_t count = len / sizeof(s16);
+    ssize_t ret;
 
-    if (count == 0 || count > MAX_SAMPLES)
+    mutex_lock(&f->lock);
+    if (f->dev->halted) {
+        mutex_unlock(&f->lock);
+        return -ENODEV;
+    }
+    if (f->ring) {
+        ret = squarer_ring_write(f, buf, len);
+        mutex_unlock(&f->lock);
+        return ret;
+    }
+
+    if (count == 0 || count > f->dev->buf_samples) {
+        mutex_unlock(&f->lock);
         return -EINVAL;
+    }
 
-    mutex_lock(&dev->lock);
+    // A second write() before the read() replaces the staged job
+    squarer_unstage(f);
 
-    if (copy_from_user(dev->input_buf, buf, count * sizeof(s16))) {
-        mutex_unlock(&dev->lock);
-        return -EFAULT;
+    // Small jobs start right away as part of a batch; read() only waits
+    ret = -ENOSPC;
+    if (count <= f->dev->batch_max)
+        ret = squarer_stage_batch(f->dev, f, buf, count);
+    if (!ret) {
+        squarer_buf_put(f);
+    } else if (ret == -ENOSPC) {
+        // Solo: stage in a pool buffer (kept by a previous solo write)
+        // and submit from read()
+        ret = squarer_buf_get(f, file->f_flags & O_NONBLOCK);
+        if (!ret && copy_from_user(f->buf->input, buf, count * sizeof(s16))) {
+            squarer_buf_put(f);
+            ret = -EFAULT;
+        }
+    }
+    if (ret) {
+        mutex_unlock(&f->lock);
+        return ret;
     }
-    dev->count = count;
+    f->count = count;
+    trace_squarer_dma_copy_in(count);
 
-    mutex_unlock(&dev->lock);
+    mutex_unlock(&f->lock);
     return count * sizeof(s16);
 }
 
 static ssize_t squarer_read(struct file *file, char __user *buf,
                             size_t len, loff_t *off)
 {
-    struct squarer_dma_dev *dev = container_of(file->private_data,
-                                    struct squarer_dma_dev, misc);
+    struct squarer_file *f = file->private_data;
+    struct squarer_dma_dev *dev = f->dev;
+    struct squarer_job *job = &f->job;
     size_t out_bytes;
-    int ret;
+    long ret;
 
-    mutex_lock(&dev->lock);
+    mutex_lock(&f->lock);
+    if (dev->halted) {
+        mutex_unlock(&f->lock);
+        return -ENODEV;
+    }
+    if (f->ring) {
+        ret = squarer_ring_read(f, buf, len, file->f_flags & O_NONBLOCK);
+        mutex_unlock(&f->lock);
+        return ret;
+    }
 
-    if (dev->count == 0) {
-        mutex_unlock(&dev->lock);
+    if (f->count == 0) {
+        mutex_unlock(&f->lock);
         return 0;
     }
 
-    out_bytes = dev->count * sizeof(s32);
+    out_bytes = f->count * sizeof(s32);
     if (len < out_bytes)
         out_bytes = (len / sizeof(s32)) * sizeof(s32);
 
-    // Start DMA transfer
-    start_dma_transfer(dev, out_bytes / sizeof(s32));
+    // Only the engine is shared; other files keep staging meanwhile. A
+    // batched job was queued by write() already.
+    if (!job->batch)
+        squarer_submit(dev, f, out_bytes / sizeof(s32));
 
-    // Wait for completion
-    ret = wait_event_interruptible_timeout(dev->wait, dev->transfer_done,
+    // Wait for completion. DMA errors and stalls complete the job with -EIO
+    // well within a millisecond; the timeout is only a last resort.
+    ret = wait_event_interruptible_timeout(dev->wait, READ_ONCE(job->done),
                                            msecs_to_jiffies(1000));
-    if (ret == 0) {
-        mutex_unlock(&dev->lock);
-        return -ETIMEDOUT;
+    trace_squarer_dma_done(job->xfer_id, out_bytes / sizeof(s32), ret);
+    if (ret <= 0)
+        ret = squarer_cancel(dev, f, ret ? ret : -ETIMEDOUT);
+    else
+        ret = job->status;
+
+    if (!ret && copy_to_user(buf, job->output, out_bytes))
+        ret = -EFAULT;
+    // The job is over: its batch reference or pool buffer goes back
+    squarer_unstage(f);
+    squarer_buf_put(f);
+    if (ret) {
+        mutex_unlock(&f->lock);
+        return ret;
     }
-    if (ret < 0) {
-        mutex_unlock(&dev->lock);
+    trace_squarer_dma_copy_out(out_bytes / sizeof(s32));
+
+    mutex_unlock(&f->lock);
+    return out_bytes;
+}
+
+static long squarer_ioctl(struct file *file, unsigned int cmd,
+                          unsigned long arg)
+{
+    struct squarer_file *f = file->private_data;
+    struct squarer_ring_config cfg;
+    __u32 cls;
+    int ret;
+
+    switch (cmd) {
+    case SQUARER_IOC_SET_CLASS:
+        if (get_user(cls, (__u32 __user *)arg))
+            return -EFAULT;
+        if (cls > SQUARER_CLASS_BULK)
+            return -EINVAL;
+        WRITE_ONCE(f->cls_mode, cls);
+        return 0;
+    case SQUARER_IOC_RING_START:
+        if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg)))
+            return -EFAULT;
+        mutex_lock(&f->lock);
+        ret = squarer_ring_start(f, &cfg, file->f_flags & O_NONBLOCK);
+        mutex_unlock(&f->lock);
         return ret;
+    case SQUARER_IOC_RING_STOP:
+        mutex_lock(&f->lock);
+        squarer_ring_stop(f);
+        mutex_unlock(&f->lock);
+        return 0;
+    default:
+        return -ENOTTY;
     }
+}
 
-    if (copy_to_user(buf, dev->output_buf, out_bytes)) {
-        mutex_unlock(&dev->lock);
-        return -EFAULT;
+static const struct file_operations squarer_fops = {
+    .owner          = THIS_MODULE,
+    .open           = squarer_open,
+    .release        = squarer_release,
+    .write          = squarer_write,
+    .read           = squarer_read,
+    .unlocked_ioctl = squarer_ioctl,
+    .compat_ioctl   = compat_ptr_ioctl,
+};
+
+static ssize_t pool_buffers_show(struct device *d, struct device_attribute *attr,
+                                 char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", dev->nbufs);
+}
+static DEVICE_ATTR_RO(pool_buffers);
+
+static ssize_t buffer_samples_show(struct device *d, struct device_attribute *attr,
+                                   char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%zu\n", dev->buf_samples);
+}
+static DEVICE_ATTR_RO(buffer_samples);
+
+// Jobs up to this many samples are batched (0 = every job goes solo)
+static ssize_t batch_max_samples_show(struct device *d,
+                                      struct device_attribute *attr, char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(dev->batch_max));
+}
+
+static ssize_t batch_max_samples_store(struct device *d,
+                                       struct device_attribute *attr,
+                                       const char *buf, size_t len)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+    u32 v;
+
+    if (kstrtou32(buf, 0, &v) || v > BATCH_SAMPLES / 2)
+        return -EINVAL;
+    WRITE_ONCE(dev->batch_max, v);
+    return len;
+}
+static DEVICE_ATTR_RW(batch_max_samples);
+
+// How long a batch started on an idle engine waits for more jobs
+static ssize_t batch_window_us_show(struct device *d,
+                                    struct device_attribute *attr, char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(dev->batch_window_us));
+}
+
+static ssize_t batch_window_us_store(struct device *d,
+                                     struct device_attribute *attr,
+                                     const char *buf, size_t len)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+    u32 v;
+
+    if (kstrtou32(buf, 0, &v) || v > USEC_PER_SEC)
+        return -EINVAL;
+    WRITE_ONCE(dev->batch_window_us, v);
+    return len;
+}
+static DEVICE_ATTR_RW(batch_window_us);
+
+// batched_jobs / batches = jobs sharing one DMA setup and IRQ
+static ssize_t batches_show(struct device *d, struct device_attribute *attr,
+                            char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_batches));
+}
+static DEVICE_ATTR_RO(batches);
+
+static ssize_t batched_jobs_show(struct device *d, struct device_attribute *attr,
+                                 char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_batched_jobs));
+}
+static DEVICE_ATTR_RO(batched_jobs);
+
+// Bulk transfers run in pieces of this many samples; 0 = only the DMA
+// length limit. Smaller means lower RT latency, more IRQs for bulk work.
+// A multiple of SAMPLE_ALIGN, so resumed pieces start aligned.
+static ssize_t bulk_chunk_samples_show(struct device *d,
+                                       struct device_attribute *attr, char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(dev->bulk_chunk));
+}
+
+static ssize_t bulk_chunk_samples_store(struct device *d,
+                                        struct device_attribute *attr,
+                                        const char *buf, size_t len)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+    u32 v;
+
+    if (kstrtou32(buf, 0, &v) || (v && v < 256) || !IS_ALIGNED(v, SAMPLE_ALIGN))
+        return -EINVAL;
+    WRITE_ONCE(dev->bulk_chunk, v);
+    return len;
+}
+static DEVICE_ATTR_RW(bulk_chunk_samples);
+
+// Bulk transfers parked at a chunk boundary for RT work
+static ssize_t preemptions_show(struct device *d, struct device_attribute *attr,
+                                char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_preemptions));
+}
+static DEVICE_ATTR_RO(preemptions);
+
+// Timer-paced ring: slots started by a wrap, and wraps with nothing queued
+static ssize_t pace_kicks_show(struct device *d, struct device_attribute *attr,
+                               char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_pace_kicks));
+}
+static DEVICE_ATTR_RO(pace_kicks);
+
+static ssize_t pace_starved_show(struct device *d, struct device_attribute *attr,
+                                 char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_pace_starved));
+}
+static DEVICE_ATTR_RO(pace_starved);
+
+static ssize_t pace_dropped_show(struct device *d, struct device_attribute *attr,
+                                 char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_pace_dropped));
+}
+static DEVICE_ATTR_RO(pace_dropped);
+
+// Error recovery: error IRQs, watchdog stalls, engine resets, chunk retries
+static ssize_t dma_errors_show(struct device *d, struct device_attribute *attr,
+                               char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_errors));
+}
+static DEVICE_ATTR_RO(dma_errors);
+
+static ssize_t dma_stalls_show(struct device *d, struct device_attribute *attr,
+                               char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_stalls));
+}
+static DEVICE_ATTR_RO(dma_stalls);
+
+static ssize_t dma_resets_show(struct device *d, struct device_attribute *attr,
+                               char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_resets));
+}
+static DEVICE_ATTR_RO(dma_resets);
+
+static ssize_t dma_retries_show(struct device *d, struct device_attribute *attr,
+                                char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+
+    return scnprintf(buf, PAGE_SIZE, "%llu\n", READ_ONCE(dev->stat_retries));
+}
+static DEVICE_ATTR_RO(dma_retries);
+
+// MM2S and S2MM DMASR as seen at the last error or stall
+static ssize_t dma_last_error_show(struct device *d,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct squarer_dma_dev *dev = dev_get_drvdata(d);
+    u32 mm2s_sr, s2mm_sr;
+
+    spin_lock_irq(&dev->lock);
+    mm2s_sr = dev->last_mm2s_sr;
+    s2mm_sr = dev->last_s2mm_sr;
+    spin_unlock_irq(&dev->lock);
+    return scnprintf(buf, PAGE_SIZE, "mm2s_sr=0x%08x s2mm_sr=0x%08x\n",
+                     mm2s_sr, s2mm_sr);
+}
+static DEVICE_ATTR_RO(dma_last_error);
+
+static struct attribute *squarer_dma_attrs[] = {
+    &dev_attr_pool_buffers.attr,
+    &dev_attr_buffer_samples.attr,
+    &dev_attr_batch_max_samples.attr,
+    &dev_attr_batch_window_us.attr,
+    &dev_attr_batches.attr,
+    &dev_attr_batched_jobs.attr,
+    &dev_attr_bulk_chunk_samples.attr,
+    &dev_attr_preemptions.attr,
+    &dev_attr_pace_kicks.attr,
+    &dev_attr_pace_starved.attr,
+    &dev_attr_pace_dropped.attr,
+    &dev_attr_dma_errors.attr,
+    &dev_attr_dma_stalls.attr,
+    &dev_attr_dma_resets.attr,
+    &dev_attr_dma_retries.attr,
+    &dev_attr_dma_last_error.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(squarer_dma);
+
+// ---------- debugfs (queueing delay per class) ----------
+
+static void sq_delay_show_one(struct seq_file *m, const char *name,
+                              const struct sq_delay_hist *h)
+{
+    int i;
+
+    seq_printf(m, "%s: count=%llu", name, h->count);
+    if (h->count)
+        seq_printf(m, " min=%u avg=%llu max=%u", h->min,
+                   div64_u64(h->sum, h->count), h->max);
+    seq_puts(m, " (ns)\n");
+    for (i = 0; i < DELAY_BUCKETS; i++) {
+        if (h->bucket[i])
+            seq_printf(m, "  [%10u, %10u) %llu\n", i ? 1u << i : 0u,
+                       i < 31 ? 1u << (i + 1) : U32_MAX, h->bucket[i]);
     }
+}
 
-    mutex_unlock(&dev->lock);
-    return out_bytes;
+static int sq_queue_delay_show(struct seq_file *m, void *v)
+{
+    struct squarer_dma_dev *dev = m->private;
+    struct sq_delay_hist *snap;
+    int c;
+
+    // Snapshot under the lock, print outside it
+    snap = kmalloc_array(SQ_NR_CLASSES, sizeof(*snap), GFP_KERNEL);
+    if (!snap)
+        return -ENOMEM;
+    spin_lock_irq(&dev->lock);
+    memcpy(snap, dev->delay, sizeof(dev->delay));
+    spin_unlock_irq(&dev->lock);
+
+    for (c = 0; c < SQ_NR_CLASSES; c++)
+        sq_delay_show_one(m, squarer_class_names[c], &snap[c]);
+    kfree(snap);
+    return 0;
 }
 
-static const struct file_operations squarer_fops = {
-    .owner = THIS_MODULE,
-    .write = squarer_write,
-    .read  = squarer_read,
+// Any write resets the histograms
+static ssize_t sq_queue_delay_write(struct file *file, const char __user *buf,
+                                    size_t len, loff_t *ppos)
+{
+    struct squarer_dma_dev *dev = file_inode(file)->i_private;
+    int c;
+
+    spin_lock_irq(&dev->lock);
+    for (c = 0; c < SQ_NR_CLASSES; c++)
+        sq_delay_reset(&dev->delay[c]);
+    spin_unlock_irq(&dev->lock);
+    return len;
+}
+
+static int sq_queue_delay_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, sq_queue_delay_show, inode->i_private);
+}
+
+static const struct file_operations sq_queue_delay_fops = {
+    .owner   = THIS_MODULE,
+    .open    = sq_queue_delay_open,
+    .read    = seq_read,
+    .write   = sq_queue_delay_write,
+    .llseek  = seq_lseek,
+    .release = single_release,
 };
 
+static void squarer_release_mem(void *data)
+{
+    of_reserved_mem_device_release(data);
+}
+
+// Size the pool from the DT node and allocate it. With a memory-region the
+// region is split evenly into demo,buffer-count buffers; each buffer is the
+// largest power of two that fits, since the coherent pool allocator hands
+// out power-of-two blocks.
+static int squarer_alloc_pool(struct platform_device *pdev,
+                              struct squarer_dma_dev *dev)
+{
+    struct device_node *np = pdev->dev.of_node;
+    struct device_node *rnp;
+    struct reserved_mem *rmem = NULL;
+    size_t buf_bytes, in_bytes;
+    u32 nbufs = DEFAULT_BUFFERS;
+    unsigned int i;
+    int ret;
+
+    of_property_read_u32(np, "demo,buffer-count", &nbufs);
+    if (nbufs == 0 || nbufs > MAX_BUFFERS) {
+        dev_err(&pdev->dev, "demo,buffer-count must be 1..%d\n", MAX_BUFFERS);
+        return -EINVAL;
+    }
+
+    rnp = of_parse_phandle(np, "memory-region", 0);
+    if (rnp) {
+        rmem = of_reserved_mem_lookup(rnp);
+        of_node_put(rnp);
+        if (!rmem)
+            return -EPROBE_DEFER;
+
+        ret = of_reserved_mem_device_init(&pdev->dev);
+        if (ret)
+            return ret;
+        ret = devm_add_action_or_reset(&pdev->dev, squarer_release_mem,
+                                       &pdev->dev);
+        if (ret)
+            return ret;
+
+        buf_bytes = rounddown_pow_of_two(rmem->size / nbufs);
+        dev->buf_samples = buf_bytes / SAMPLE_BYTES;
+    } else {
+        dev->buf_samples = DEFAULT_SAMPLES;
+    }
+
+    // Keep the output half cache-line aligned
+    dev->buf_samples = ALIGN_DOWN(dev->buf_samples, SAMPLE_ALIGN);
+    if (dev->buf_samples == 0)
+        return -EINVAL;
+    in_bytes = dev->buf_samples * sizeof(s16);
+    buf_bytes = dev->buf_samples * SAMPLE_BYTES;
+
+    for (i = 0; i < nbufs; i++) {
+        struct squarer_buf *b = &dev->bufs[i];
+
+        b->input = dmam_alloc_coherent(&pdev->dev, buf_bytes, &b->input_dma,
+                                       GFP_KERNEL);
+        if (!b->input) {
+            dev_err(&pdev->dev, "buffer %u of %u (%zu bytes) failed\n",
+                    i, nbufs, buf_bytes);
+            return -ENOMEM;
+        }
+        b->output = (s32 *)((u8 *)b->input + in_bytes);
+        b->output_dma = b->input_dma + in_bytes;
+    }
+    dev->nbufs = nbufs;
+
+    dev_info(&pdev->dev, "pool: %u x %zu samples (%s)\n", nbufs,
+             dev->buf_samples, rmem ? rmem->name : "default CMA");
+    return 0;
+}
+
+// Batch staging buffers come from the default CMA area, so they must be
+// allocated before the device is bound to its memory-region
+static int squarer_alloc_batches(struct platform_device *pdev,
+                                 struct squarer_dma_dev *dev)
+{
+    size_t in_bytes = BATCH_SAMPLES * sizeof(s16);
+    int i;
+
+    for (i = 0; i < BATCH_SLOTS; i++) {
+        struct squarer_batch *b = &dev->batches[i];
+
+        b->buf.input = dmam_alloc_coherent(&pdev->dev,
+                                           BATCH_SAMPLES * SAMPLE_BYTES,
+                                           &b->buf.input_dma, GFP_KERNEL);
+        if (!b->buf.input)
+            return -ENOMEM;
+        b->buf.output = (s32 *)((u8 *)b->buf.input + in_bytes);
+        b->buf.output_dma = b->buf.input_dma + in_bytes;
+
+        b->xfer.batch = b;
+        b->xfer.input_dma = b->buf.input_dma;
+        b->xfer.output_dma = b->buf.output_dma;
+        INIT_LIST_HEAD(&b->xfer.node);
+        INIT_LIST_HEAD(&b->xfer.jobs);
+    }
+    return 0;
+}
+
 static int squarer_dma_probe(struct platform_device *pdev)
 {
     struct squarer_dma_dev *dev;
     struct resource *res;
-    int irq, ret;
+    u32 len_width = DEFAULT_LEN_WIDTH;
+    int irq, ret, c;
 
-    dev = devm_kzalloc(&pdev->dev, sizeof(*dev), GFP_KERNEL);
+    dev = kzalloc(sizeof(*dev), GFP_KERNEL);
     if (!dev)
         return -ENOMEM;
+    kref_init(&dev->ref);
+    ret = devm_add_action_or_reset(&pdev->dev, squarer_dev_put, dev);
+    if (ret)
+        return ret;
+    mutex_init(&dev->files_lock);
+    INIT_LIST_HEAD(&dev->files);
 
     // Map DMA registers
     res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -170,67 +1725,114 @@ static int squarer_dma_probe(struct platform_device *pdev)
     if (IS_ERR(dev->dma_base))
         return PTR_ERR(dev->dma_base);
 
-    // Allocate DMA coherent buffers
-    dev->input_buf = dma_alloc_coherent(&pdev->dev,
-                        MAX_SAMPLES * sizeof(s16), &dev->input_dma, GFP_KERNEL);
-    if (!dev->input_buf)
-        return -ENOMEM;
+    // Allocate the batch slots, then the DMA buffer pool
+    ret = squarer_alloc_batches(pdev, dev);
+    if (ret)
+        return ret;
+    spin_lock_init(&dev->pool_lock);
+    init_waitqueue_head(&dev->pool_wait);
+    ret = squarer_alloc_pool(pdev, dev);
+    if (ret)
+        return ret;
 
-    dev->output_buf = dma_alloc_coherent(&pdev->dev,
-                        MAX_SAMPLES * sizeof(s32), &dev->output_dma, GFP_KERNEL);
-    if (!dev->output_buf) {
-        dma_free_coherent(&pdev->dev, MAX_SAMPLES * sizeof(s16),
-                          dev->input_buf, dev->input_dma);
-        return -ENOMEM;
-    }
+    // S2MM moves 4 bytes per sample; stay under the length register limit.
+    // Chunks after the first start at max_chunk multiples, so keep it aligned.
+    of_property_read_u32(pdev->dev.of_node, "xlnx,sg-length-width", &len_width);
+    len_width = clamp_t(u32, len_width, 8, 26);
+    dev->max_chunk = ALIGN_DOWN(((1U << len_width) - 1) / sizeof(s32),
+                                SAMPLE_ALIGN);
 
-    mutex_init(&dev->lock);
+    spin_lock_init(&dev->lock);
+    for (c = 0; c < SQ_NR_CLASSES; c++) {
+        INIT_LIST_HEAD(&dev->queue[c]);
+        sq_delay_reset(&dev->delay[c]);
+    }
+    dev->bulk_chunk = DEFAULT_BULK_CHUNK;
     init_waitqueue_head(&dev->wait);
+    hrtimer_init(&dev->batch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    dev->batch_timer.function = squarer_batch_timeout;
+    dev->batch_max = DEFAULT_BATCH_MAX;
+    dev->batch_window_us = DEFAULT_BATCH_WINDOW_US;
+
+    hrtimer_init(&dev->wd_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    dev->wd_timer.function = squarer_wd_timeout;
 
     // Enable DMA channels
-    writel(DMACR_RS | DMACR_IOC_IRQ_EN, dev->dma_base + MM2S_DMACR);
-    writel(DMACR_RS | DMACR_IOC_IRQ_EN, dev->dma_base + S2MM_DMACR);
+    squarer_dma_enable(dev);
 
-    // Request IRQ
+    // Request IRQ: s2mm_introut, plus mm2s_introut if it is wired too
     irq = platform_get_irq(pdev, 0);
-    if (irq < 0) {
-        ret = irq;
-        goto err_free_dma;
-    }
+    if (irq < 0)
+        return irq;
 
     ret = devm_request_irq(&pdev->dev, irq, squarer_dma_irq, 0, DRV_NAME, dev);
     if (ret)
-        goto err_free_dma;
+        return ret;
+
+    irq = platform_get_irq_optional(pdev, 1);
+    if (irq > 0) {
+        ret = devm_request_irq(&pdev->dev, irq, squarer_dma_irq, 0, DRV_NAME, dev);
+        if (ret)
+            return ret;
+    }
 
     dev->misc.minor = MISC_DYNAMIC_MINOR;
     dev->misc.name = "squarer_dma";
     dev->misc.fops = &squarer_fops;
 
+    platform_set_drvdata(pdev, dev);
+
     ret = misc_register(&dev->misc);
     if (ret)
-        goto err_free_dma;
+        return ret;
+
+    dev->dbg_dir = debugfs_create_dir(dev_name(&pdev->dev), NULL);
+    debugfs_create_file("queue_delay", 0644, dev->dbg_dir, dev,
+                        &sq_queue_delay_fops);
 
-    platform_set_drvdata(pdev, dev);
     dev_info(&pdev->dev, "squarer_dma: registered /dev/squarer_dma\n");
     return 0;
-
-err_free_dma:
-    dma_free_coherent(&pdev->dev, MAX_SAMPLES * sizeof(s32),
-                      dev->output_buf, dev->output_dma);
-    dma_free_coherent(&pdev->dev, MAX_SAMPLES * sizeof(s16),
-                      dev->input_buf, dev->input_dma);
-    return ret;
 }
 
 static int squarer_dma_remove(struct platform_device *pdev)
 {
     struct squarer_dma_dev *dev = platform_get_drvdata(pdev);
+    struct squarer_file *f;
+    u32 mm2s_sr, s2mm_sr;
 
+    debugfs_remove_recursive(dev->dbg_dir);
     misc_deregister(&dev->misc);
-    dma_free_coherent(&pdev->dev, MAX_SAMPLES * sizeof(s32),
-                      dev->output_buf, dev->output_dma);
-    dma_free_coherent(&pdev->dev, MAX_SAMPLES * sizeof(s16),
-                      dev->input_buf, dev->input_dma);
+
+    // devm frees the buffers and unmaps the registers after this returns,
+    // so the engine must be stopped first: reset it and leave it halted,
+    // and fail the transfer on it and everything queued
+    spin_lock_irq(&dev->lock);
+    dev->halted = true;
+    squarer_abort_active(dev, -ENODEV);
+    spin_unlock_irq(&dev->lock);
+    wake_up_all(&dev->wait);
+    wake_up_interruptible_all(&dev->pool_wait);
+
+    // Files that stay open keep dev, but nothing else: detach their rings
+    // from the timer and drop their jobs and buffers. Any call still inside
+    // a file operation has woken up and fails; later ones see halted.
+    mutex_lock(&dev->files_lock);
+    list_for_each_entry(f, &dev->files, node) {
+        mutex_lock(&f->lock);
+        squarer_file_detach(f);
+        mutex_unlock(&f->lock);
+    }
+    mutex_unlock(&dev->files_lock);
+
+    // No file can restart either timer now
+    hrtimer_cancel(&dev->wd_timer);
+    hrtimer_cancel(&dev->batch_timer);
+
+    if (readl_poll_timeout(dev->dma_base + MM2S_DMASR, mm2s_sr,
+                           mm2s_sr & DMASR_HALTED, 1, RESET_TIMEOUT_US) ||
+        readl_poll_timeout(dev->dma_base + S2MM_DMASR, s2mm_sr,
+                           s2mm_sr & DMASR_HALTED, 1, RESET_TIMEOUT_US))
+        dev_warn(&pdev->dev, "DMA did not halt\n");
     return 0;
 }
 
@@ -244,6 +1846,7 @@ static struct platform_driver squarer_dma_driver = {
     .driver = {
         .name = DRV_NAME,
         .of_match_table = squarer_dma_of_match,
+        .dev_groups = squarer_dma_groups,
     },
     .probe  = squarer_dma_probe,
     .remove = squarer_dma_remove,
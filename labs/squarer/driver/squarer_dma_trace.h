@@ -0,0 +1,128 @@
+// Trace events for the squarer DMA driver
+// Phases of one job: submit -> start -> irq -> done -> copy_out. A solo job
+// is submitted from read(), a batched one from write() before its input is
+// copied in (copy_in). id names the DMA transfer carrying the job, shared by
+// all jobs of a batch, so start and irq (which run for whoever is waiting)
+// can be matched to it.
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM squarer_dma
+
+#if !defined(_SQUARER_DMA_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SQUARER_DMA_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(squarer_dma_count,
+    TP_PROTO(size_t count),
+    TP_ARGS(count),
+    TP_STRUCT__entry(
+        __field(size_t, count)
+    ),
+    TP_fast_assign(
+        __entry->count = count;
+    ),
+    TP_printk("count=%zu", __entry->count)
+);
+
+// write(): input copied from userspace
+DEFINE_EVENT(squarer_dma_count, squarer_dma_copy_in,
+    TP_PROTO(size_t count), TP_ARGS(count));
+
+// Output copied back to userspace
+DEFINE_EVENT(squarer_dma_count, squarer_dma_copy_out,
+    TP_PROTO(size_t count), TP_ARGS(count));
+
+DECLARE_EVENT_CLASS(squarer_dma_xfer,
+    TP_PROTO(u32 id, size_t count),
+    TP_ARGS(id, count),
+    TP_STRUCT__entry(
+        __field(u32, id)
+        __field(size_t, count)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __entry->count = count;
+    ),
+    TP_printk("id=%u count=%zu", __entry->id, __entry->count)
+);
+
+// Job queued: on transfer id, count samples of it
+DEFINE_EVENT(squarer_dma_xfer, squarer_dma_submit,
+    TP_PROTO(u32 id, size_t count), TP_ARGS(id, count));
+
+// Both DMA channels programmed (one per chunk; may run in IRQ context)
+DEFINE_EVENT(squarer_dma_xfer, squarer_dma_start,
+    TP_PROTO(u32 id, size_t count), TP_ARGS(id, count));
+
+// Small jobs packed into one transfer and queued for the engine
+TRACE_EVENT(squarer_dma_batch,
+    TP_PROTO(unsigned int jobs, size_t count),
+    TP_ARGS(jobs, count),
+    TP_STRUCT__entry(
+        __field(unsigned int, jobs)
+        __field(size_t, count)
+    ),
+    TP_fast_assign(
+        __entry->jobs = jobs;
+        __entry->count = count;
+    ),
+    TP_printk("jobs=%u count=%zu", __entry->jobs, __entry->count)
+);
+
+// id: the transfer whose chunk was on the engine
+TRACE_EVENT(squarer_dma_irq,
+    TP_PROTO(u32 id, u32 s2mm_status),
+    TP_ARGS(id, s2mm_status),
+    TP_STRUCT__entry(
+        __field(u32, id)
+        __field(u32, s2mm_status)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __entry->s2mm_status = s2mm_status;
+    ),
+    TP_printk("id=%u s2mm_sr=0x%08x", __entry->id, __entry->s2mm_status)
+);
+
+// Error IRQ or watchdog stall; the engine is reset next
+TRACE_EVENT(squarer_dma_error,
+    TP_PROTO(u32 mm2s_status, u32 s2mm_status),
+    TP_ARGS(mm2s_status, s2mm_status),
+    TP_STRUCT__entry(
+        __field(u32, mm2s_status)
+        __field(u32, s2mm_status)
+    ),
+    TP_fast_assign(
+        __entry->mm2s_status = mm2s_status;
+        __entry->s2mm_status = s2mm_status;
+    ),
+    TP_printk("mm2s_sr=0x%08x s2mm_sr=0x%08x", __entry->mm2s_status,
+              __entry->s2mm_status)
+);
+
+// Waiter woke up (ret: remaining jiffies, 0 on timeout, <0 on signal)
+TRACE_EVENT(squarer_dma_done,
+    TP_PROTO(u32 id, size_t count, long ret),
+    TP_ARGS(id, count, ret),
+    TP_STRUCT__entry(
+        __field(u32, id)
+        __field(size_t, count)
+        __field(long, ret)
+    ),
+    TP_fast_assign(
+        __entry->id = id;
+        __entry->count = count;
+        __entry->ret = ret;
+    ),
+    TP_printk("id=%u count=%zu ret=%ld", __entry->id, __entry->count,
+              __entry->ret)
+);
+
+#endif  // _SQUARER_DMA_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE squarer_dma_trace
+#include <trace/define_trace.h>
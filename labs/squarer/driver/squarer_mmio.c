@@ -16,6 +16,9 @@
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 
+#define CREATE_TRACE_POINTS
+#include "squarer_mmio_trace.h"
+
 #define DRV_NAME "squarer_mmio"
 #define MAX_SAMPLES (256 * 1024)  // 256K samples: 512KB input, 1MB output
 
@@ -76,12 +79,14 @@ static ssize_t squarer_read(struct file *file, char __user *buf,
         out_bytes = (len / sizeof(s32)) * sizeof(s32);
 
     // This is the slow path: one register write + read per sample
+    trace_squarer_mmio_batch_start(out_bytes / sizeof(s32));
     for (i = 0; i < out_bytes / sizeof(s32); i++) {
         // Write input to hardware
         writel((u32)(u16)dev->input_buf[i], dev->base + REG_DATA_IN);
         // Read result from hardware
         dev->output_buf[i] = (s32)readl(dev->base + REG_DATA_OUT);
     }
+    trace_squarer_mmio_batch_end(out_bytes / sizeof(s32));
 
     if (copy_to_user(buf, dev->output_buf, out_bytes)) {
         mutex_unlock(&dev->lock);
@@ -0,0 +1,35 @@
+// Trace events for the squarer MMIO driver: one start/end pair per read()
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM squarer_mmio
+
+#if !defined(_SQUARER_MMIO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SQUARER_MMIO_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(squarer_mmio_batch,
+    TP_PROTO(size_t count),
+    TP_ARGS(count),
+    TP_STRUCT__entry(
+        __field(size_t, count)
+    ),
+    TP_fast_assign(
+        __entry->count = count;
+    ),
+    TP_printk("count=%zu", __entry->count)
+);
+
+DEFINE_EVENT(squarer_mmio_batch, squarer_mmio_batch_start,
+    TP_PROTO(size_t count), TP_ARGS(count));
+
+DEFINE_EVENT(squarer_mmio_batch, squarer_mmio_batch_end,
+    TP_PROTO(size_t count), TP_ARGS(count));
+
+#endif  // _SQUARER_MMIO_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE squarer_mmio_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,35 @@
+// Squarer DMA userspace interface (shared by driver and applications)
+#ifndef SQUARER_UAPI_H
+#define SQUARER_UAPI_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+// Scheduling class for the requests (read() calls) on one fd. RT requests
+// are served before queued bulk ones and preempt a running bulk transfer at
+// its next chunk boundary.
+#define SQUARER_CLASS_AUTO 0  // per read(): RT if the caller is SCHED_FIFO/RR/DEADLINE
+#define SQUARER_CLASS_RT   1
+#define SQUARER_CLASS_BULK 2
+
+#define SQUARER_IOC_MAGIC 'Q'
+// SQUARER_IOC_SET_CLASS: set this fd's class (__u32, SQUARER_CLASS_*)
+#define SQUARER_IOC_SET_CLASS _IOW(SQUARER_IOC_MAGIC, 1, __u32)
+
+// Timer-paced ring: each wrap of /dev/smarttimer<timer> starts the next
+// queued slot, with no syscall per period. write() queues exactly one slot
+// of input (samples * 2 bytes), ENOSPC when all slots are queued or unread;
+// read() blocks until the oldest queued slot completes and returns its
+// output (samples * 4 bytes), or 0 if none is queued. Slots live in this
+// fd's pool buffer: slots * samples <= sysfs buffer_samples. Needs the
+// smarttimer_blocking module loaded.
+struct squarer_ring_config {
+    __u32 timer;    // smart timer instance number
+    __u32 slots;    // 2..64
+    __u32 samples;  // per slot, a multiple of 32
+};
+
+#define SQUARER_IOC_RING_START _IOW(SQUARER_IOC_MAGIC, 2, struct squarer_ring_config)
+#define SQUARER_IOC_RING_STOP  _IO(SQUARER_IOC_MAGIC, 3)
+
+#endif  // SQUARER_UAPI_H
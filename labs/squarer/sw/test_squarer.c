@@ -14,8 +14,8 @@
 #include <errno.h>
 
 #define DEFAULT_SAMPLES 1024
-// Note: Both drivers have a 256K sample limit (pre-allocated buffers).
-// Drivers will return -EINVAL if this limit is exceeded.
+// Note: squarer_mmio has a 256K sample limit; squarer_dma's limit is its pool
+// buffer size (sysfs buffer_samples). Drivers return -EINVAL above the limit.
 
 // Get time in nanoseconds
 static uint64_t get_time_ns(void)
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+# Per-stage latency breakdown from squarer/smarttimer trace events.
+#
+# Capture on the board, e.g.:
+#   trace-cmd record -e squarer_dma -e squarer_mmio -e smarttimer ./test_squarer 4096
+#   trace-cmd report > trace.txt
+# or
+#   perf record -e 'squarer_dma:*' -e 'squarer_mmio:*' -e 'smarttimer:*' -a -- ./test_squarer
+#   perf script > trace.txt
+# (a copy of /sys/kernel/tracing/trace works too), then on any host:
+#   ./trace-breakdown.py trace.txt [--clock-mhz 100]
+
+import argparse
+import re
+import sys
+from collections import defaultdict
+
+# "<ts>: [system:]event: args" - common to ftrace, trace-cmd report and perf script
+EVENT_RE = re.compile(r"(?P<ts>\d+\.\d+):\s+(?:\w+:)?(?P<event>(?:squarer_dma|squarer_mmio|smarttimer)_\w+):\s*(?P<args>.*)$")
+# ftrace/trace-cmd "comm-pid [cpu]" or perf "comm pid [cpu]"
+PID_RE = re.compile(r"[-\s](?P<pid>\d+)\s+\[\d+\]")
+ARG_RE = re.compile(r"(\w+)=(-?\w+)")
+
+
+def parse(lines):
+    for line in lines:
+        m = EVENT_RE.search(line)
+        if not m:
+            continue
+        p = PID_RE.search(line[:m.start()])
+        args = {k: v for k, v in ARG_RE.findall(m.group("args"))}
+        yield float(m.group("ts")), int(p.group("pid")) if p else -1, m.group("event"), args
+
+
+def summarize(name, samples, unit="us"):
+    if not samples:
+        return
+    s = sorted(samples)
+    n = len(s)
+    avg = sum(s) / n
+    p50 = s[n // 2]
+    p99 = s[min(n - 1, (n * 99) // 100)]
+    print(f"  {name:<14} n={n:<7} min={s[0]:10.2f} avg={avg:10.2f} "
+          f"p50={p50:10.2f} p99={p99:10.2f} max={s[-1]:10.2f}  {unit}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Per-stage latency breakdown from trace events")
+    ap.add_argument("trace", nargs="?", help="text capture (default: stdin)")
+    ap.add_argument("--clock-mhz", type=float, default=100.0,
+                    help="PL clock for smarttimer cycle counts (default 100)")
+    opts = ap.parse_args()
+
+    src = open(opts.trace) if opts.trace else sys.stdin
+    stages = defaultdict(list)
+
+    dma_req = {}        # (transfer id, pid) -> {stage: ts}
+    dma_done = {}       # pid -> request whose done event came last
+    batches = []        # jobs per batch transfer
+    mmio_start = {}     # pid -> ts
+    cyc_us = 1.0 / opts.clock_mhz
+
+    for ts, pid, ev, args in parse(src):
+        if ev == "squarer_dma_submit":
+            # Submitted by the requester; a batch transfer carries several
+            dma_req[(args.get("id"), pid)] = {"submit": ts}
+        elif ev in ("squarer_dma_start", "squarer_dma_irq"):
+            # Both run for whoever is waiting (start often from the IRQ), so
+            # match them to requests by transfer id. The first chunk of a
+            # split transfer is its start, the last IRQ is its completion.
+            stage = "start" if ev == "squarer_dma_start" else "irq"
+            for (xid, _), r in dma_req.items():
+                if xid == args.get("id") and "done" not in r:
+                    if stage == "irq":
+                        r["irq"] = ts
+                    else:
+                        r.setdefault("start", ts)
+        elif ev == "squarer_dma_done":
+            r = dma_req.pop((args.get("id"), pid), None)
+            if r:
+                r["done"] = ts
+                dma_done[pid] = r
+        elif ev == "squarer_dma_batch":
+            batches.append(int(args.get("jobs", "0")))
+        elif ev == "squarer_dma_copy_out":
+            # Same read() as the done event just before it on this pid
+            r = dma_done.pop(pid, None)
+            if not r:
+                continue
+            r["copy_out"] = ts
+            for name, a, b in (("queue_wait", "submit", "start"),
+                               ("dma_hw", "start", "irq"),
+                               ("irq_to_wake", "irq", "done"),
+                               ("copy_out", "done", "copy_out"),
+                               ("total", "submit", "copy_out")):
+                if a in r and b in r:
+                    stages["squarer_dma " + name].append((r[b] - r[a]) * 1e6)
+        elif ev == "squarer_mmio_batch_start":
+            mmio_start[pid] = ts
+        elif ev == "squarer_mmio_batch_end":
+            t0 = mmio_start.pop(pid, None)
+            if t0 is not None:
+                us = (ts - t0) * 1e6
+                stages["squarer_mmio batch"].append(us)
+                count = int(args.get("count", "0"))
+                if count:
+                    stages["squarer_mmio per_sample"].append(us / count)
+        elif ev == "smarttimer_irq":
+            tid = args.get("id", "0")
+            stages[f"smarttimer{tid} wrap_to_irq"].append(int(args["latency_cyc"]) * cyc_us)
+        elif ev == "smarttimer_wakeup":
+            tid = args.get("id", "0")
+            stages[f"smarttimer{tid} irq_to_reader"].append(int(args["latency_cyc"]) * cyc_us)
+
+    if batches:
+        stages["squarer_dma jobs_per_batch"] = batches
+
+    if not stages:
+        print("no squarer/smarttimer events found", file=sys.stderr)
+        return 1
+
+    group = None
+    for key in sorted(stages, key=lambda k: k.split(" ", 1)[0]):  # stable: keeps stage order
+        g, stage = key.split(" ", 1)
+        if g != group:
+            print(g)
+            group = g
+        summarize(stage, stages[key], "jobs" if stage == "jobs_per_batch" else "us")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
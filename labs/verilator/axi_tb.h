@@ -0,0 +1,229 @@
+// Minimal Verilator testbench layer: clocking, FST window, AXI-Lite master,
+// AXI-Stream stall generator. Header-only; each tb_*.cpp includes it.
+//
+// Timing convention: tick() leaves clk high just after a rising edge. Drive
+// inputs, call settle() to see the DUT outputs for the *next* edge, then
+// tick(). A handshake happens on an edge where valid && ready were both
+// high after settle().
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "verilated.h"
+#include "verilated_fst_c.h"
+
+// ---------- command line ----------
+
+struct TbOptions {
+    uint64_t cycles = 1000000;     // simulated cycles (timer tests)
+    uint64_t samples = 256 * 1024; // samples (squarer tests)
+    uint32_t seed = 1;
+    int backpressure = 0;          // % of cycles the sink stalls
+    std::string fst;               // dump file, empty = no tracing
+    uint64_t fst_start = 0;        // dump window [fst_start, fst_end) in cycles
+    uint64_t fst_end = UINT64_MAX;
+
+    TbOptions(int argc, char** argv) {
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            auto val = [&]() -> const char* {
+                if (i + 1 >= argc) usage(argv[0]);
+                return argv[++i];
+            };
+            if (a == "--cycles") cycles = strtoull(val(), nullptr, 0);
+            else if (a == "--samples") samples = strtoull(val(), nullptr, 0);
+            else if (a == "--seed") seed = strtoul(val(), nullptr, 0);
+            else if (a == "--backpressure") backpressure = atoi(val());
+            else if (a == "--fst") fst = val();
+            else if (a == "--fst-start") fst_start = strtoull(val(), nullptr, 0);
+            else if (a == "--fst-end") fst_end = strtoull(val(), nullptr, 0);
+            else if (a[0] == '+') continue;  // leave +args to Verilated
+            else usage(argv[0]);
+        }
+    }
+
+    [[noreturn]] static void usage(const char* prog) {
+        fprintf(stderr,
+                "usage: %s [--cycles N] [--samples N] [--seed S] [--backpressure PCT]\n"
+                "          [--fst FILE [--fst-start CYCLE] [--fst-end CYCLE]]\n",
+                prog);
+        exit(2);
+    }
+};
+
+// ---------- clock, reset, tracing, stats ----------
+
+template <class Model>
+class Tb {
+public:
+    Tb(int argc, char** argv, const TbOptions& opt)
+        : opt_(opt), ctx_(new VerilatedContext), top(new Model(ctx_.get())) {
+        ctx_->commandArgs(argc, argv);
+        if (!opt_.fst.empty()) {
+            ctx_->traceEverOn(true);
+            fst_.reset(new VerilatedFstC);
+            top->trace(fst_.get(), 99);
+        }
+        top->clk = 1;
+        top->eval();
+        t0_ = std::chrono::steady_clock::now();
+    }
+
+    ~Tb() {
+        if (fst_ && fst_->isOpen()) fst_->close();
+        top->final();
+    }
+
+    // Propagate combinational paths from the current inputs
+    void settle() { top->eval(); }
+
+    void tick() {
+        top->clk = 0;
+        top->eval();
+        dump(2 * cycles);
+        top->clk = 1;
+        top->eval();
+        cycles++;
+        dump(2 * cycles + 1);
+    }
+
+    void ticks(uint64_t n) {
+        while (n--) tick();
+    }
+
+    // Simulated cycles per wall-clock second since construction
+    void report(const char* name) const {
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0_).count();
+        printf("%s: %llu cycles in %.3f s = %.2f Mcycles/s\n", name,
+               (unsigned long long)cycles, s, s > 0 ? cycles / s / 1e6 : 0.0);
+    }
+
+    uint64_t cycles = 0;
+
+private:
+    void dump(uint64_t t) {
+        if (!fst_ || cycles < opt_.fst_start || cycles >= opt_.fst_end) {
+            if (fst_ && fst_->isOpen() && cycles >= opt_.fst_end) fst_->close();
+            return;
+        }
+        if (!fst_->isOpen()) fst_->open(opt_.fst.c_str());
+        fst_->dump(t);
+    }
+
+    const TbOptions& opt_;
+    std::unique_ptr<VerilatedContext> ctx_;
+    std::unique_ptr<VerilatedFstC> fst_;
+    std::chrono::steady_clock::time_point t0_;
+
+public:
+    std::unique_ptr<Model> top;
+};
+
+// ---------- AXI-Lite master ----------
+
+// Pointers to one AXI-Lite slave port of a Verilated model. Build with
+// AXIL_PORTS(model_ptr, prefix), e.g. AXIL_PORTS(tb.top, s_axi).
+struct AxilPorts {
+    IData* awaddr; CData* awvalid; CData* awready;
+    IData* wdata;  CData* wstrb;   CData* wvalid; CData* wready;
+    CData* bvalid; CData* bready;
+    IData* araddr; CData* arvalid; CData* arready;
+    IData* rdata;  CData* rvalid;  CData* rready;
+};
+
+#define AXIL_PORTS(m, p)                                                   \
+    AxilPorts {                                                            \
+        &(m)->p##_awaddr, &(m)->p##_awvalid, &(m)->p##_awready,            \
+        &(m)->p##_wdata, &(m)->p##_wstrb, &(m)->p##_wvalid, &(m)->p##_wready, \
+        &(m)->p##_bvalid, &(m)->p##_bready,                                \
+        &(m)->p##_araddr, &(m)->p##_arvalid, &(m)->p##_arready,            \
+        &(m)->p##_rdata, &(m)->p##_rvalid, &(m)->p##_rready                \
+    }
+
+class AxilMaster {
+public:
+    AxilMaster(AxilPorts p, std::function<void()> settle, std::function<void()> tick)
+        : p_(p), settle_(std::move(settle)), tick_(std::move(tick)) {
+        idle();
+    }
+
+    void idle() {
+        *p_.awvalid = 0;
+        *p_.wvalid = 0;
+        *p_.bready = 0;
+        *p_.arvalid = 0;
+        *p_.rready = 0;
+    }
+
+    void write(uint32_t addr, uint32_t data, uint8_t strb = 0xF) {
+        bool aw = false, w = false;
+        *p_.awaddr = addr;
+        *p_.awvalid = 1;
+        *p_.wdata = data;
+        *p_.wstrb = strb;
+        *p_.wvalid = 1;
+        *p_.bready = 1;
+        for (unsigned n = 0; n < kTimeout; n++) {
+            settle_();
+            bool aw_hs = !aw && *p_.awready;
+            bool w_hs = !w && *p_.wready;
+            bool b_hs = (aw || aw_hs) && (w || w_hs) && *p_.bvalid;
+            tick_();
+            if (aw_hs) { aw = true; *p_.awvalid = 0; }
+            if (w_hs) { w = true; *p_.wvalid = 0; }
+            if (b_hs) { *p_.bready = 0; return; }
+        }
+        fail("write", addr);
+    }
+
+    uint32_t read(uint32_t addr) {
+        bool ar = false;
+        *p_.araddr = addr;
+        *p_.arvalid = 1;
+        *p_.rready = 1;
+        for (unsigned n = 0; n < kTimeout; n++) {
+            settle_();
+            bool ar_hs = !ar && *p_.arready;
+            bool r_hs = (ar || ar_hs) && *p_.rvalid;  // slaves may raise both at once
+            uint32_t data = *p_.rdata;
+            tick_();
+            if (ar_hs) { ar = true; *p_.arvalid = 0; }
+            if (r_hs) { *p_.rready = 0; return data; }
+        }
+        fail("read", addr);
+    }
+
+private:
+    static constexpr unsigned kTimeout = 1000;
+
+    [[noreturn]] static void fail(const char* what, uint32_t addr) {
+        fprintf(stderr, "AXI-Lite %s @0x%02x timed out\n", what, addr);
+        exit(1);
+    }
+
+    AxilPorts p_;
+    std::function<void()> settle_;
+    std::function<void()> tick_;
+};
+
+// ---------- AXI-Stream ----------
+
+// Simple random stall generator for valid/ready pacing
+class Stall {
+public:
+    Stall(uint32_t seed, int pct) : rng_(seed), pct_(pct) {}
+    bool operator()() { return pct_ > 0 && int(rng_() % 100) < pct_; }
+
+private:
+    std::mt19937 rng_;
+    int pct_;
+};